@@ -0,0 +1,307 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define CAPTURE_QUEUE_SIZE 64
+#define CAPTURE_MAX_ROWS 64
+#define CAPTURE_MAX_COLS 128
+#define CAPTURE_CELL_PIXELS 8
+#define CAPTURE_RAW_MAGIC "VGCR"
+#define CAPTURE_RAW_VERSION 1
+#define CAPTURE_DEFAULT_FPS 30
+
+typedef enum {
+    CAPTURE_RAW,
+    CAPTURE_PPM,
+    CAPTURE_Y4M
+} CaptureFormat;
+
+typedef struct {
+    uint32_t seq;
+    uint64_t time_ns;
+    int rows;
+    int cols;
+    char cells[CAPTURE_MAX_ROWS * CAPTURE_MAX_COLS];
+} CaptureFrame;
+
+/*
+ * Single-producer/single-consumer ring: the game loop only advances `head`,
+ * the encoder thread only advances `tail`. A full ring drops the frame.
+ * The raw dump keeps every frame's seq and timestamp. PPM and Y4M streams
+ * are resampled to `fps` from the timestamps instead: `held` is the newest
+ * frame not yet written, and it is repeated over every output slot until
+ * the slot of the frame that replaced it, so coalesced or dropped frames
+ * show the old picture for as long as it was on screen.
+ */
+typedef struct {
+    FILE *file;
+    CaptureFormat format;
+    pthread_t thread;
+    atomic_int running;
+    atomic_size_t head;
+    atomic_size_t tail;
+    CaptureFrame slots[CAPTURE_QUEUE_SIZE];
+    char last_cells[CAPTURE_MAX_ROWS * CAPTURE_MAX_COLS];
+    int last_rows;
+    int last_cols;
+    uint32_t seq;
+    int fps;
+    uint64_t base_ns;
+    uint64_t stop_ns;
+    CaptureFrame held;
+    int has_held;
+    uint64_t held_slot;
+    int header_written;
+    unsigned long captured;
+    unsigned long dropped;
+    unsigned long coalesced;
+    unsigned long encoded;
+    uint64_t producer_ns;
+    uint64_t encoder_ns;
+    unsigned char pixels[CAPTURE_MAX_ROWS * CAPTURE_MAX_COLS * CAPTURE_CELL_PIXELS * CAPTURE_CELL_PIXELS * 3];
+} Capture;
+
+static Capture capture;
+static int capture_enabled = 0;
+
+static inline uint64_t capture_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline int capture_headless() {
+    const char *headless = getenv("VGC_HEADLESS");
+    return headless != NULL && strcmp(headless, "0") != 0;
+}
+
+static inline void capture_cell_color(char cell, unsigned char rgb[3]) {
+    switch (cell) {
+        case '#': rgb[0] = 160; rgb[1] = 160; rgb[2] = 160; break;
+        case 'O': rgb[0] = 255; rgb[1] = 255; rgb[2] = 255; break;
+        case '|': rgb[0] = 80;  rgb[1] = 200; rgb[2] = 80;  break;
+        case 'X': rgb[0] = 220; rgb[1] = 60;  rgb[2] = 60;  break;
+        case '.': rgb[0] = 24;  rgb[1] = 24;  rgb[2] = 32;  break;
+        default:  rgb[0] = 0;   rgb[1] = 0;   rgb[2] = 0;   break;
+    }
+}
+
+static inline void capture_rasterize(const CaptureFrame *frame, int channels) {
+    int width = frame->cols * CAPTURE_CELL_PIXELS;
+    for (int row = 0; row < frame->rows; row++) {
+        for (int col = 0; col < frame->cols; col++) {
+            unsigned char rgb[3];
+            capture_cell_color(frame->cells[row * frame->cols + col], rgb);
+            unsigned char luma = (unsigned char)((rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8);
+            for (int py = 0; py < CAPTURE_CELL_PIXELS; py++) {
+                unsigned char *out = capture.pixels +
+                    ((size_t)(row * CAPTURE_CELL_PIXELS + py) * width + col * CAPTURE_CELL_PIXELS) * channels;
+                for (int px = 0; px < CAPTURE_CELL_PIXELS; px++) {
+                    int gap = px == CAPTURE_CELL_PIXELS - 1 || py == CAPTURE_CELL_PIXELS - 1;
+                    if (channels == 1) {
+                        *out++ = gap ? 0 : luma;
+                    } else {
+                        *out++ = gap ? 0 : rgb[0];
+                        *out++ = gap ? 0 : rgb[1];
+                        *out++ = gap ? 0 : rgb[2];
+                    }
+                }
+            }
+        }
+    }
+}
+
+static inline void capture_write_frame(const CaptureFrame *frame) {
+    int width = frame->cols * CAPTURE_CELL_PIXELS;
+    int height = frame->rows * CAPTURE_CELL_PIXELS;
+
+    if (capture.format == CAPTURE_RAW) {
+        uint16_t rows = (uint16_t)frame->rows, cols = (uint16_t)frame->cols;
+        fwrite(&frame->seq, sizeof(frame->seq), 1, capture.file);
+        fwrite(&frame->time_ns, sizeof(frame->time_ns), 1, capture.file);
+        fwrite(&rows, sizeof(rows), 1, capture.file);
+        fwrite(&cols, sizeof(cols), 1, capture.file);
+        fwrite(frame->cells, 1, (size_t)frame->rows * frame->cols, capture.file);
+    } else if (capture.format == CAPTURE_PPM) {
+        capture_rasterize(frame, 3);
+        fprintf(capture.file, "P6\n%d %d\n255\n", width, height);
+        fwrite(capture.pixels, 3, (size_t)width * height, capture.file);
+    } else {
+        if (!capture.header_written) {
+            fprintf(capture.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n", width, height, capture.fps);
+            capture.header_written = 1;
+        }
+        capture_rasterize(frame, 1);
+        fprintf(capture.file, "FRAME\n");
+        fwrite(capture.pixels, 1, (size_t)width * height, capture.file);
+    }
+}
+
+static inline uint64_t capture_slot(uint64_t time_ns) {
+    return time_ns > capture.base_ns ? (time_ns - capture.base_ns) * capture.fps / 1000000000ULL : 0;
+}
+
+/* Writes the held frame into every output slot before `slot`. */
+static inline void capture_write_held(uint64_t slot) {
+    if (!capture.has_held) {
+        return;
+    }
+    for (uint64_t i = capture.held_slot; i < slot; i++) {
+        capture_write_frame(&capture.held);
+    }
+    if (slot > capture.held_slot) {
+        capture.held_slot = slot;
+    }
+}
+
+static inline void capture_encode(const CaptureFrame *frame) {
+    uint64_t start = capture_now_ns();
+    if (capture.format == CAPTURE_RAW) {
+        capture_write_frame(frame);
+    } else {
+        if (!capture.has_held) {
+            capture.base_ns = frame->time_ns;
+        }
+        uint64_t slot = capture_slot(frame->time_ns);
+        capture_write_held(slot);
+        memcpy(&capture.held, frame, sizeof(*frame));
+        capture.held_slot = slot;
+        capture.has_held = 1;
+    }
+    capture.encoded++;
+    capture.encoder_ns += capture_now_ns() - start;
+}
+
+static inline void *capture_thread(void *arg) {
+    (void)arg;
+    struct timespec idle = {0, 2000000};
+    for (;;) {
+        size_t tail = atomic_load_explicit(&capture.tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&capture.head, memory_order_acquire);
+        if (tail == head) {
+            if (!atomic_load_explicit(&capture.running, memory_order_acquire)) {
+                break;
+            }
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        capture_encode(&capture.slots[tail % CAPTURE_QUEUE_SIZE]);
+        atomic_store_explicit(&capture.tail, tail + 1, memory_order_release);
+    }
+    if (capture.format != CAPTURE_RAW && capture.has_held) {
+        uint64_t end = capture_slot(capture.stop_ns);
+        capture_write_held(end > capture.held_slot ? end + 1 : capture.held_slot + 1);
+    }
+    fflush(capture.file);
+    return NULL;
+}
+
+static inline void capture_start() {
+    const char *path = getenv("VGC_CAPTURE");
+    if (path == NULL || *path == '\0' || capture_enabled) {
+        return;
+    }
+    const char *format = getenv("VGC_CAPTURE_FORMAT");
+    const char *ext = strrchr(path, '.');
+    if (format == NULL) {
+        format = ext != NULL ? ext + 1 : "raw";
+    }
+    capture.format = strcmp(format, "ppm") == 0 ? CAPTURE_PPM :
+                     strcmp(format, "y4m") == 0 ? CAPTURE_Y4M : CAPTURE_RAW;
+
+    capture.file = fopen(path, "wb");
+    if (capture.file == NULL) {
+        perror("Error opening capture file");
+        return;
+    }
+    if (capture.format == CAPTURE_RAW) {
+        uint32_t version = CAPTURE_RAW_VERSION;
+        fwrite(CAPTURE_RAW_MAGIC, 1, 4, capture.file);
+        fwrite(&version, sizeof(version), 1, capture.file);
+    }
+    const char *fps = getenv("VGC_CAPTURE_FPS");
+    capture.fps = fps != NULL && atoi(fps) > 0 ? atoi(fps) : CAPTURE_DEFAULT_FPS;
+    capture.seq = 0;
+    capture.has_held = 0;
+    capture.held_slot = 0;
+    capture.last_rows = 0;
+    capture.last_cols = 0;
+    capture.header_written = 0;
+    capture.captured = capture.dropped = capture.coalesced = capture.encoded = 0;
+    capture.producer_ns = capture.encoder_ns = 0;
+    atomic_store(&capture.head, 0);
+    atomic_store(&capture.tail, 0);
+    atomic_store(&capture.running, 1);
+    if (pthread_create(&capture.thread, NULL, capture_thread, NULL) != 0) {
+        perror("Error starting capture thread");
+        fclose(capture.file);
+        return;
+    }
+    capture_enabled = 1;
+}
+
+/* Called from the draw path with the composed cell grid; never blocks. */
+static inline void capture_frame(const char *cells, int rows, int cols) {
+    if (!capture_enabled) {
+        return;
+    }
+    uint64_t start = capture_now_ns();
+    if (rows > CAPTURE_MAX_ROWS) rows = CAPTURE_MAX_ROWS;
+    if (cols > CAPTURE_MAX_COLS) cols = CAPTURE_MAX_COLS;
+
+    capture.seq++;
+    if (rows == capture.last_rows && cols == capture.last_cols &&
+        memcmp(cells, capture.last_cells, (size_t)rows * cols) == 0) {
+        capture.coalesced++;
+        capture.producer_ns += capture_now_ns() - start;
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&capture.head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&capture.tail, memory_order_acquire);
+    if (head - tail >= CAPTURE_QUEUE_SIZE) {
+        capture.dropped++;
+        capture.producer_ns += capture_now_ns() - start;
+        return;
+    }
+    CaptureFrame *slot = &capture.slots[head % CAPTURE_QUEUE_SIZE];
+    slot->seq = capture.seq;
+    slot->time_ns = start;
+    slot->rows = rows;
+    slot->cols = cols;
+    memcpy(slot->cells, cells, (size_t)rows * cols);
+    atomic_store_explicit(&capture.head, head + 1, memory_order_release);
+
+    memcpy(capture.last_cells, cells, (size_t)rows * cols);
+    capture.last_rows = rows;
+    capture.last_cols = cols;
+    capture.captured++;
+    capture.producer_ns += capture_now_ns() - start;
+}
+
+static inline void capture_stop() {
+    if (!capture_enabled) {
+        return;
+    }
+    capture_enabled = 0;
+    capture.stop_ns = capture_now_ns();
+    atomic_store_explicit(&capture.running, 0, memory_order_release);
+    pthread_join(capture.thread, NULL);
+    fclose(capture.file);
+
+    unsigned long calls = capture.captured + capture.dropped + capture.coalesced;
+    fprintf(stderr, "capture: %lu frames queued, %lu dropped, %lu coalesced\n",
+            capture.captured, capture.dropped, capture.coalesced);
+    fprintf(stderr, "capture: game loop overhead %.2f us/frame, encoder %.2f us/frame\n",
+            calls ? capture.producer_ns / 1000.0 / calls : 0.0,
+            capture.encoded ? capture.encoder_ns / 1000.0 / capture.encoded : 0.0);
+}
+
+#endif
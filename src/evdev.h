@@ -0,0 +1,359 @@
+#ifndef EVDEV_H
+#define EVDEV_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <linux/input.h>
+
+#define EVDEV_MAX_DEVICES 16
+#define EVDEV_DIR "/dev/input"
+#define EVDEV_BITS(n) (((n) + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)))
+#define EVDEV_TEST_BIT(bits, n) (((bits)[(n) / (8 * sizeof(unsigned long))] >> ((n) % (8 * sizeof(unsigned long)))) & 1UL)
+
+typedef void (*EvdevEmit)(char key, unsigned char pressed, int64_t time_ns);
+typedef void (*EvdevAdded)(int index);
+
+/* `keys` holds the mapped key codes this device currently has down. */
+typedef struct {
+    int fd;
+    dev_t rdev;
+    int keyboard;
+    int syncing;
+    unsigned long keys[EVDEV_BITS(KEY_CNT)];
+    int x_min, x_max;
+    int y_min, y_max;
+    char hat_x, hat_y;
+    char stick_x, stick_y;
+} EvdevDevice;
+
+/*
+ * Keyboards and pads read straight from /dev/input/event*. `held` counts how
+ * many physical inputs hold each action key so that a pad and a keyboard
+ * pressing the same direction produce one press and one release. After a
+ * SYN_DROPPED or an unplug each device's own state is diffed against the
+ * kernel's, or released, so a lost release cannot leave an action held.
+ * Kernel autorepeat (value 2) is dropped: games get real releases instead.
+ */
+typedef struct {
+    EvdevDevice devices[EVDEV_MAX_DEVICES];
+    int count;
+    int has_keyboard;
+    int watch_fd;
+    unsigned char held[256];
+} Evdev;
+
+static Evdev evdev;
+
+static const struct {
+    int code;
+    char key;
+} evdev_keymap[] = {
+    {KEY_W, 'w'}, {KEY_A, 'a'}, {KEY_S, 's'}, {KEY_D, 'd'}, {KEY_Q, 'q'},
+    {KEY_R, 'r'}, {KEY_K, 'k'}, {KEY_L, 'l'}, {KEY_SPACE, ' '}, {KEY_ENTER, '\r'},
+    {KEY_UP, 'w'}, {KEY_LEFT, 'a'}, {KEY_DOWN, 's'}, {KEY_RIGHT, 'd'}, {KEY_ESC, 'q'},
+    {BTN_DPAD_UP, 'w'}, {BTN_DPAD_LEFT, 'a'}, {BTN_DPAD_DOWN, 's'}, {BTN_DPAD_RIGHT, 'd'},
+    {BTN_SOUTH, 'w'}, {BTN_EAST, ' '}, {BTN_TL, 'r'}, {BTN_START, '\r'}, {BTN_SELECT, 'q'},
+};
+
+static inline int evdev_requested() {
+    const char *backend = getenv("VGC_INPUT");
+    return (backend != NULL && strcmp(backend, "evdev") == 0) || getenv("VGC_EVDEV_DEVICE") != NULL;
+}
+
+static inline int64_t evdev_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline char evdev_key_action(int code) {
+    for (size_t i = 0; i < sizeof(evdev_keymap) / sizeof(evdev_keymap[0]); i++) {
+        if (evdev_keymap[i].code == code) {
+            return evdev_keymap[i].key;
+        }
+    }
+    return 0;
+}
+
+static inline void evdev_set(char key, int pressed, int64_t time_ns, EvdevEmit emit) {
+    unsigned char *held = &evdev.held[(unsigned char)key];
+    if (pressed) {
+        if ((*held)++ == 0) {
+            emit(key, 1, time_ns);
+        }
+    } else if (*held > 0) {
+        if (--(*held) == 0) {
+            emit(key, 0, time_ns);
+        }
+    }
+}
+
+static inline void evdev_axis(char *current, char next, int64_t time_ns, EvdevEmit emit) {
+    if (*current == next) {
+        return;
+    }
+    if (*current) {
+        evdev_set(*current, 0, time_ns, emit);
+    }
+    if (next) {
+        evdev_set(next, 1, time_ns, emit);
+    }
+    *current = next;
+}
+
+static inline char evdev_stick(int value, int min, int max, char low, char high) {
+    int quarter = (max - min) / 4;
+    int center = min + (max - min) / 2;
+    if (quarter <= 0) return 0;
+    if (value < center - quarter) return low;
+    if (value > center + quarter) return high;
+    return 0;
+}
+
+static inline void evdev_key(EvdevDevice *device, int code, int pressed, int64_t time_ns, EvdevEmit emit) {
+    char key = evdev_key_action(code);
+    if (!key || code < 0 || code >= KEY_CNT) {
+        return;
+    }
+    unsigned long *word = &device->keys[code / (8 * sizeof(unsigned long))];
+    unsigned long bit = 1UL << (code % (8 * sizeof(unsigned long)));
+    if (((*word & bit) != 0) == (pressed != 0)) {
+        return;
+    }
+    *word ^= bit;
+    evdev_set(key, pressed, time_ns, emit);
+}
+
+static inline void evdev_abs(EvdevDevice *device, int code, int value, int64_t time_ns, EvdevEmit emit) {
+    if (code == ABS_HAT0X) {
+        evdev_axis(&device->hat_x, value < 0 ? 'a' : value > 0 ? 'd' : 0, time_ns, emit);
+    } else if (code == ABS_HAT0Y) {
+        evdev_axis(&device->hat_y, value < 0 ? 'w' : value > 0 ? 's' : 0, time_ns, emit);
+    } else if (code == ABS_X) {
+        evdev_axis(&device->stick_x, evdev_stick(value, device->x_min, device->x_max, 'a', 'd'), time_ns, emit);
+    } else if (code == ABS_Y) {
+        evdev_axis(&device->stick_y, evdev_stick(value, device->y_min, device->y_max, 'w', 's'), time_ns, emit);
+    }
+}
+
+/* Re-reads key and axis state from the kernel after events were dropped. */
+static inline void evdev_resync(EvdevDevice *device, EvdevEmit emit) {
+    static const int axes[] = {ABS_HAT0X, ABS_HAT0Y, ABS_X, ABS_Y};
+    unsigned long state[EVDEV_BITS(KEY_CNT)] = {0};
+    int64_t now = evdev_now_ns();
+
+    if (ioctl(device->fd, EVIOCGKEY(sizeof(state)), state) >= 0) {
+        for (size_t i = 0; i < sizeof(evdev_keymap) / sizeof(evdev_keymap[0]); i++) {
+            int code = evdev_keymap[i].code;
+            evdev_key(device, code, EVDEV_TEST_BIT(state, code), now, emit);
+        }
+    }
+    for (size_t i = 0; i < sizeof(axes) / sizeof(axes[0]); i++) {
+        struct input_absinfo info;
+        if (ioctl(device->fd, EVIOCGABS(axes[i]), &info) == 0) {
+            evdev_abs(device, axes[i], info.value, now, emit);
+        }
+    }
+}
+
+static inline void evdev_release_all(EvdevDevice *device, EvdevEmit emit) {
+    int64_t now = evdev_now_ns();
+    for (size_t i = 0; i < sizeof(evdev_keymap) / sizeof(evdev_keymap[0]); i++) {
+        evdev_key(device, evdev_keymap[i].code, 0, now, emit);
+    }
+    evdev_axis(&device->hat_x, 0, now, emit);
+    evdev_axis(&device->hat_y, 0, now, emit);
+    evdev_axis(&device->stick_x, 0, now, emit);
+    evdev_axis(&device->stick_y, 0, now, emit);
+}
+
+/* Returns the new device's index, or -1 if it is not a keyboard or pad or is already open. */
+static inline int evdev_add(const char *path) {
+    unsigned long ev_bits[EVDEV_BITS(EV_CNT)] = {0};
+    unsigned long key_bits[EVDEV_BITS(KEY_CNT)] = {0};
+    unsigned long abs_bits[EVDEV_BITS(ABS_CNT)] = {0};
+
+    struct stat st;
+    int index = 0;
+
+    while (index < evdev.count && evdev.devices[index].fd >= 0) {
+        index++;
+    }
+    if (index >= EVDEV_MAX_DEVICES) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    for (int i = 0; i < evdev.count; i++) {
+        if (evdev.devices[i].fd >= 0 && evdev.devices[i].rdev == st.st_rdev) {
+            close(fd);
+            return -1;
+        }
+    }
+    ioctl(fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits);
+    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits);
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits);
+
+    int keyboard = EVDEV_TEST_BIT(key_bits, KEY_W) && EVDEV_TEST_BIT(key_bits, KEY_Q);
+    int pad = EVDEV_TEST_BIT(key_bits, BTN_GAMEPAD) || EVDEV_TEST_BIT(key_bits, BTN_DPAD_UP);
+    if (!EVDEV_TEST_BIT(ev_bits, EV_KEY) || (!keyboard && !pad)) {
+        close(fd);
+        return -1;
+    }
+
+    int clock = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clock);
+
+    EvdevDevice *device = &evdev.devices[index];
+    memset(device, 0, sizeof(*device));
+    device->fd = fd;
+    device->rdev = st.st_rdev;
+    device->keyboard = keyboard;
+    if (index == evdev.count) {
+        evdev.count++;
+    }
+    if (EVDEV_TEST_BIT(abs_bits, ABS_X)) {
+        struct input_absinfo info;
+        if (ioctl(fd, EVIOCGABS(ABS_X), &info) == 0) {
+            device->x_min = info.minimum;
+            device->x_max = info.maximum;
+        }
+        if (ioctl(fd, EVIOCGABS(ABS_Y), &info) == 0) {
+            device->y_min = info.minimum;
+            device->y_max = info.maximum;
+        }
+    }
+    if (keyboard) {
+        evdev.has_keyboard = 1;
+    }
+    return index;
+}
+
+/*
+ * Opens VGC_EVDEV_DEVICE, or every keyboard and pad under /dev/input. In the
+ * latter case `watch_fd` reports devices that appear later, see evdev_hotplug().
+ */
+static inline int evdev_open() {
+    memset(&evdev, 0, sizeof(evdev));
+    evdev.watch_fd = -1;
+    if (!evdev_requested()) {
+        return 0;
+    }
+    const char *device = getenv("VGC_EVDEV_DEVICE");
+    if (device != NULL) {
+        evdev_add(device);
+        return evdev.count;
+    }
+    evdev.watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (evdev.watch_fd >= 0 && inotify_add_watch(evdev.watch_fd, EVDEV_DIR, IN_CREATE | IN_ATTRIB) < 0) {
+        close(evdev.watch_fd);
+        evdev.watch_fd = -1;
+    }
+    DIR *dir = opendir(EVDEV_DIR);
+    if (dir == NULL) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "event", 5) == 0) {
+            char path[300];
+            snprintf(path, sizeof(path), "%s/%s", EVDEV_DIR, entry->d_name);
+            evdev_add(path);
+        }
+    }
+    closedir(dir);
+    return evdev.count;
+}
+
+/* Opens event nodes announced on `watch_fd`; udev's later chmod shows up as IN_ATTRIB. */
+static inline void evdev_hotplug(EvdevAdded added) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t nread;
+
+    while ((nread = read(evdev.watch_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + nread;) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len > 0 && strncmp(event->name, "event", 5) == 0) {
+                char path[300];
+                snprintf(path, sizeof(path), "%s/%s", EVDEV_DIR, event->name);
+                int index = evdev_add(path);
+                if (index >= 0) {
+                    added(index);
+                }
+            }
+            p += sizeof(*event) + event->len;
+        }
+    }
+}
+
+static inline void evdev_remove(EvdevDevice *device) {
+    close(device->fd);
+    device->fd = -1;
+    evdev.has_keyboard = 0;
+    for (int i = 0; i < evdev.count; i++) {
+        if (evdev.devices[i].fd >= 0 && evdev.devices[i].keyboard) {
+            evdev.has_keyboard = 1;
+        }
+    }
+}
+
+/* Drains one non-blocking device; returns -1 once it has been unplugged. */
+static inline int evdev_read(EvdevDevice *device, EvdevEmit emit) {
+    struct input_event events[64];
+    ssize_t nread;
+
+    while ((nread = read(device->fd, events, sizeof(events))) > 0) {
+        for (size_t i = 0; i < (size_t)nread / sizeof(events[0]); i++) {
+            struct input_event *ev = &events[i];
+            int64_t time_ns = (int64_t)ev->input_event_sec * 1000000000LL + (int64_t)ev->input_event_usec * 1000;
+            if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+                device->syncing = 1;
+            } else if (device->syncing) {
+                if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
+                    device->syncing = 0;
+                    evdev_resync(device, emit);
+                }
+            } else if (ev->type == EV_KEY && ev->value != 2) {
+                evdev_key(device, ev->code, ev->value, time_ns, emit);
+            } else if (ev->type == EV_ABS) {
+                evdev_abs(device, ev->code, ev->value, time_ns, emit);
+            }
+        }
+    }
+    if (nread < 0 && errno == ENODEV) {
+        evdev_release_all(device, emit);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void evdev_close() {
+    for (int i = 0; i < evdev.count; i++) {
+        if (evdev.devices[i].fd >= 0) {
+            close(evdev.devices[i].fd);
+        }
+    }
+    if (evdev.watch_fd >= 0) {
+        close(evdev.watch_fd);
+        evdev.watch_fd = -1;
+    }
+    evdev.count = 0;
+}
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "evdev.h"
+
+#define INPUT_QUEUE_SIZE 256
+#define INPUT_READ_SIZE 256
+#define INPUT_STOP_TAG -1
+#define INPUT_STDIN_TAG -2
+#define INPUT_HOTPLUG_TAG -3
+#define INPUT_ESCAPE_TIMEOUT_MS 30
+
+typedef enum {
+    INPUT_SOURCE_TTY,
+    INPUT_SOURCE_EVDEV
+} InputSource;
+
+/* TTY events are presses only, a held key repeats at the terminal's rate. */
+typedef struct {
+    char key;
+    unsigned char pressed;
+    unsigned char source;
+    int64_t time_ns;
+} InputEvent;
+
+typedef enum {
+    INPUT_PLAIN,
+    INPUT_ESCAPE,
+    INPUT_SEQUENCE
+} InputDecodeState;
+
+/*
+ * The reader thread is the only producer and the game loop the only
+ * consumer of `events`; `ready_fd` is an eventfd the game loop can select()
+ * on, `stop_fd` wakes the reader when the game ends. Terminal bytes only
+ * produce presses; evdev devices (VGC_INPUT=evdev) also produce releases.
+ */
+typedef struct {
+    pthread_t thread;
+    int running;
+    int ready_fd;
+    int stop_fd;
+    int epoll_fd;
+    int local_console;
+    atomic_size_t head;
+    atomic_size_t tail;
+    InputEvent events[INPUT_QUEUE_SIZE];
+    InputDecodeState state;
+    int64_t escape_time_ns;
+    unsigned long dropped;
+    unsigned long applied;
+    int64_t latency_total_ns;
+    int64_t latency_max_ns;
+} Input;
+
+static Input input;
+
+static inline int64_t input_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline void input_enqueue(char key, unsigned char pressed, int64_t time_ns, InputSource source) {
+    size_t head = atomic_load_explicit(&input.head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&input.tail, memory_order_acquire);
+    if (head - tail >= INPUT_QUEUE_SIZE) {
+        input.dropped++;
+        return;
+    }
+    InputEvent *event = &input.events[head % INPUT_QUEUE_SIZE];
+    event->key = key;
+    event->pressed = pressed;
+    event->source = source;
+    event->time_ns = time_ns;
+    atomic_store_explicit(&input.head, head + 1, memory_order_release);
+}
+
+static inline void input_push(char key, int64_t time_ns) {
+    input_enqueue(key, 1, time_ns, INPUT_SOURCE_TTY);
+}
+
+static inline void input_push_evdev(char key, unsigned char pressed, int64_t time_ns) {
+    input_enqueue(key, pressed, time_ns, INPUT_SOURCE_EVDEV);
+}
+
+/*
+ * Arrow keys arrive as ESC [ A..D (or ESC O A..D) and map onto w/s/d/a.
+ * The decode state carries over between reads, so a sequence split across
+ * reads still decodes; only a lone ESC is flushed, by input_escape_timeout().
+ */
+static inline void input_decode(const char *bytes, ssize_t count, int64_t time_ns) {
+    for (ssize_t i = 0; i < count; i++) {
+        char c = bytes[i];
+        if (input.state == INPUT_ESCAPE) {
+            if (c == '[' || c == 'O') {
+                input.state = INPUT_SEQUENCE;
+                continue;
+            }
+            input.state = INPUT_PLAIN;
+            input_push('\033', time_ns);
+        } else if (input.state == INPUT_SEQUENCE) {
+            if (c >= 0x40 && c <= 0x7e) {
+                input.state = INPUT_PLAIN;
+                if (c == 'A') input_push('w', time_ns);
+                else if (c == 'B') input_push('s', time_ns);
+                else if (c == 'C') input_push('d', time_ns);
+                else if (c == 'D') input_push('a', time_ns);
+            }
+            continue;
+        }
+        if (c == '\033') {
+            input.state = INPUT_ESCAPE;
+            input.escape_time_ns = time_ns;
+        } else {
+            input_push(c, time_ns);
+        }
+    }
+}
+
+static inline void input_read_stdin(int epoll_fd) {
+    char bytes[INPUT_READ_SIZE];
+    ssize_t nread = read(STDIN_FILENO, bytes, sizeof(bytes));
+    int64_t now = input_now_ns();
+
+    if (nread < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (nread <= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+        return;
+    }
+    /* On the local console an evdev keyboard already reports these keys, with releases. */
+    if (evdev.has_keyboard && input.local_console) {
+        return;
+    }
+    input_decode(bytes, nread, now);
+}
+
+/* epoll_wait() timeout: -1, or how long an unfinished escape sequence may still wait. */
+static inline int input_escape_wait_ms() {
+    if (input.state == INPUT_PLAIN) {
+        return -1;
+    }
+    int64_t left = input.escape_time_ns + INPUT_ESCAPE_TIMEOUT_MS * 1000000LL - input_now_ns();
+    return left > 0 ? (int)((left + 999999) / 1000000) : 0;
+}
+
+/* A lone ESC is the Escape key; an unterminated sequence is dropped. */
+static inline int input_escape_timeout() {
+    if (input.state == INPUT_PLAIN || input_escape_wait_ms() > 0) {
+        return 0;
+    }
+    if (input.state == INPUT_ESCAPE) {
+        input_push('\033', input.escape_time_ns);
+    }
+    input.state = INPUT_PLAIN;
+    return 1;
+}
+
+static inline void input_watch_device(int index) {
+    struct epoll_event watch;
+    watch.events = EPOLLIN;
+    watch.data.u64 = (uint64_t)index;
+    epoll_ctl(input.epoll_fd, EPOLL_CTL_ADD, evdev.devices[index].fd, &watch);
+}
+
+static inline void *input_thread(void *arg) {
+    (void)arg;
+    struct epoll_event ready[8];
+    struct epoll_event watch;
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (epoll_fd < 0) {
+        return NULL;
+    }
+    watch.events = EPOLLIN;
+    watch.data.u64 = (uint64_t)(int64_t)INPUT_STOP_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, input.stop_fd, &watch);
+    watch.data.u64 = (uint64_t)(int64_t)INPUT_STDIN_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &watch);
+    if (evdev.watch_fd >= 0) {
+        watch.data.u64 = (uint64_t)(int64_t)INPUT_HOTPLUG_TAG;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, evdev.watch_fd, &watch);
+    }
+    input.epoll_fd = epoll_fd;
+    for (int i = 0; i < evdev.count; i++) {
+        input_watch_device(i);
+    }
+
+    for (;;) {
+        int count = epoll_wait(epoll_fd, ready, 8, input_escape_wait_ms());
+        int stop = 0;
+        for (int i = 0; i < count; i++) {
+            int64_t tag = (int64_t)ready[i].data.u64;
+            if (tag == INPUT_STOP_TAG) {
+                stop = 1;
+            } else if (tag == INPUT_STDIN_TAG) {
+                input_read_stdin(epoll_fd);
+            } else if (tag == INPUT_HOTPLUG_TAG) {
+                evdev_hotplug(input_watch_device);
+            } else {
+                EvdevDevice *device = &evdev.devices[tag];
+                if (device->fd >= 0 && evdev_read(device, input_push_evdev) < 0) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device->fd, NULL);
+                    evdev_remove(device);
+                }
+            }
+        }
+        if (stop) {
+            break;
+        }
+        if (input_escape_timeout() || count > 0) {
+            uint64_t one = 1;
+            write(input.ready_fd, &one, sizeof(one));
+        }
+    }
+    close(epoll_fd);
+    return NULL;
+}
+
+/*
+ * Whether stdin is a virtual console fed by the local keyboards. Over SSH or
+ * a serial line the tty carries a remote player's keys, so it is kept even
+ * when a local evdev keyboard is open.
+ */
+static inline int input_stdin_is_console() {
+    const char *name = ttyname(STDIN_FILENO);
+    if (name == NULL) {
+        return 0;
+    }
+    if (strcmp(name, "/dev/console") == 0) {
+        return 1;
+    }
+    return strncmp(name, "/dev/tty", 8) == 0 && name[8] >= '0' && name[8] <= '9';
+}
+
+static inline int input_start() {
+    memset(&input, 0, sizeof(input));
+    input.local_console = input_stdin_is_console();
+    input.ready_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    input.stop_fd = eventfd(0, EFD_CLOEXEC);
+    evdev_open();
+    if (input.ready_fd < 0 || input.stop_fd < 0 ||
+        pthread_create(&input.thread, NULL, input_thread, NULL) != 0) {
+        if (input.ready_fd >= 0) close(input.ready_fd);
+        if (input.stop_fd >= 0) close(input.stop_fd);
+        evdev_close();
+        return -1;
+    }
+    input.running = 1;
+    return 0;
+}
+
+/* Clear the eventfd before draining so a push that races the drain still wakes select(). */
+static inline void input_clear_ready() {
+    uint64_t count;
+    read(input.ready_fd, &count, sizeof(count));
+}
+
+static inline int input_pop(InputEvent *event) {
+    size_t tail = atomic_load_explicit(&input.tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&input.head, memory_order_acquire);
+    if (tail == head) {
+        return 0;
+    }
+    *event = input.events[tail % INPUT_QUEUE_SIZE];
+    atomic_store_explicit(&input.tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+/* Called once the game has applied an event to its state. */
+static inline void input_applied(const InputEvent *event) {
+    int64_t latency = input_now_ns() - event->time_ns;
+    input.applied++;
+    input.latency_total_ns += latency;
+    if (latency > input.latency_max_ns) {
+        input.latency_max_ns = latency;
+    }
+}
+
+static inline void input_stop() {
+    if (!input.running) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(input.stop_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(input.thread, NULL);
+    }
+    close(input.ready_fd);
+    close(input.stop_fd);
+    evdev_close();
+    input.running = 0;
+
+    const char *stats = getenv("VGC_INPUT_STATS");
+    if (stats != NULL && strcmp(stats, "0") != 0 && input.applied > 0) {
+        fprintf(stderr, "input: %lu events, key-to-state latency avg %.1f us, max %.1f us, %lu dropped\n",
+                input.applied, input.latency_total_ns / 1000.0 / input.applied,
+                input.latency_max_ns / 1000.0, input.dropped);
+    }
+}
+
+#endif
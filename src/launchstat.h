@@ -0,0 +1,44 @@
+#ifndef LAUNCHSTAT_H
+#define LAUNCHSTAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LAUNCHSTAT_LOG "launch.log"
+
+/*
+ * The launcher exports VGC_LAUNCH_NS (CLOCK_MONOTONIC before fork) and
+ * VGC_LAUNCH_WARM (whether the binary was resident in the page cache);
+ * the first drawn frame appends the time-to-first-frame to the log.
+ */
+static int launchstat_reported = 0;
+
+static inline void launchstat_begin() {
+    launchstat_reported = 0;
+}
+
+static inline void launchstat_first_frame(const char *game) {
+    if (launchstat_reported) {
+        return;
+    }
+    launchstat_reported = 1;
+
+    const char *launch_ns = getenv("VGC_LAUNCH_NS");
+    const char *warm = getenv("VGC_LAUNCH_WARM");
+    if (launch_ns == NULL) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long elapsed = (long long)now.tv_sec * 1000000000LL + now.tv_nsec - atoll(launch_ns);
+
+    FILE *log = fopen(LAUNCHSTAT_LOG, "a");
+    if (log == NULL) {
+        return;
+    }
+    fprintf(log, "%s %s %lld us\n", game, warm != NULL && *warm == '1' ? "warm" : "cold", elapsed / 1000);
+    fclose(log);
+}
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,16 +7,37 @@
 #include <signal.h>
 #include <termios.h>
 #include <ctype.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
+#include "plugin.h"
+
 #define MAX_GAMES 100
 #define GAME_PREFIX "game_"
+#define PLUGIN_SUFFIX ".so"
+#define RECENT_FILE ".recent"
 
 struct termios orig_termios;
 
 char *games[MAX_GAMES];
+int game_has_executable[MAX_GAMES];
+int game_has_plugin[MAX_GAMES];
 int num_games = 0;
 
+/*
+ * Each loaded plugin keeps its memfd open in plugin_fds: glibc matches
+ * dlopen() paths by name, so a reused /proc/self/fd/N would hand back the
+ * previous game's handle.
+ */
+void *plugin_handles[MAX_GAMES];
+int plugin_fds[MAX_GAMES];
+struct stat plugin_stats[MAX_GAMES];
+
 const char *menu_options[] = {"Start", "Game", "Quit"};
 const int num_menu_options = 3;
 int selected_option = 0;
@@ -23,6 +45,13 @@ int selected_option = 0;
 int current_game_index = 0;
 
 pid_t game_pid = -1;
+VgcGame *running_game = NULL;
+
+char *recent_games[MAX_GAMES];
+int num_recent = 0;
+
+void *pinned_game = NULL;
+size_t pinned_size = 0;
 
 void disableRawMode() {
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
@@ -42,6 +71,11 @@ void handle_signal(int signum) {
     if (game_pid > 0) {
         kill(game_pid, SIGTERM);
     }
+    output_finish();
+    if (running_game != NULL) {
+        running_game->shutdown();
+        input_stop();
+    }
     disableRawMode();
     exit(0);
 }
@@ -55,19 +89,41 @@ void scan_games() {
         exit(1);
     }
 
-    while ((entry = readdir(dir)) != NULL) {
-        if (strncmp(entry->d_name, GAME_PREFIX, strlen(GAME_PREFIX)) == 0) {
-            if (access(entry->d_name, X_OK) == 0) {
-                char *game_name = strdup(entry->d_name + strlen(GAME_PREFIX));
-                if (game_name == NULL) {
-                    perror("Failed to allocate memory");
-                    closedir(dir);
-                    exit(1);
-                }
-                games[num_games] = game_name;
-                num_games++;
-                if (num_games >= MAX_GAMES) break;
+    while ((entry = readdir(dir)) != NULL && num_games < MAX_GAMES) {
+        if (strncmp(entry->d_name, GAME_PREFIX, strlen(GAME_PREFIX)) != 0) {
+            continue;
+        }
+        char name[256];
+        snprintf(name, sizeof(name), "%s", entry->d_name + strlen(GAME_PREFIX));
+        size_t len = strlen(name);
+        int plugin = len > strlen(PLUGIN_SUFFIX) &&
+                     strcmp(name + len - strlen(PLUGIN_SUFFIX), PLUGIN_SUFFIX) == 0;
+        if (plugin) {
+            name[len - strlen(PLUGIN_SUFFIX)] = '\0';
+        } else if (access(entry->d_name, X_OK) != 0) {
+            continue;
+        }
+
+        int index = 0;
+        while (index < num_games && strcmp(games[index], name) != 0) {
+            index++;
+        }
+        if (index == num_games) {
+            char *game_name = strdup(name);
+            if (game_name == NULL) {
+                perror("Failed to allocate memory");
+                closedir(dir);
+                exit(1);
             }
+            games[num_games] = game_name;
+            game_has_executable[num_games] = 0;
+            game_has_plugin[num_games] = 0;
+            num_games++;
+        }
+        if (plugin) {
+            game_has_plugin[index] = 1;
+        } else {
+            game_has_executable[index] = 1;
         }
     }
     closedir(dir);
@@ -78,6 +134,255 @@ void scan_games() {
     }
 }
 
+void game_path(int index, char *path, size_t size) {
+    snprintf(path, size, "./%s%s", GAME_PREFIX, games[index]);
+}
+
+void plugin_path(int index, char *path, size_t size) {
+    snprintf(path, size, "./%s%s%s", GAME_PREFIX, games[index], PLUGIN_SUFFIX);
+}
+
+void launch_path(int index, char *path, size_t size) {
+    if (game_has_plugin[index]) {
+        plugin_path(index, path, size);
+    } else {
+        game_path(index, path, size);
+    }
+}
+
+void load_recent() {
+    FILE *file = fopen(RECENT_FILE, "r");
+    if (file == NULL) {
+        return;
+    }
+    char line[256];
+    while (num_recent < MAX_GAMES && fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] != '\0') {
+            recent_games[num_recent++] = strdup(line);
+        }
+    }
+    fclose(file);
+}
+
+void save_recent(const char *game) {
+    FILE *file = fopen(RECENT_FILE, "w");
+    if (file == NULL) {
+        return;
+    }
+    fprintf(file, "%s\n", game);
+    for (int i = 0; i < num_recent; i++) {
+        if (strcmp(recent_games[i], game) != 0) {
+            fprintf(file, "%s\n", recent_games[i]);
+        }
+    }
+    fclose(file);
+
+    for (int i = 0; i < num_recent; i++) {
+        free(recent_games[i]);
+    }
+    num_recent = 0;
+    load_recent();
+}
+
+void prefetch_game(int index) {
+    char path[256];
+    struct stat st;
+    launch_path(index, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) == 0) {
+        posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+        readahead(fd, 0, st.st_size);
+    }
+    close(fd);
+}
+
+void *prefetch_games(void *arg) {
+    int *order = arg;
+    for (int i = 0; i < num_games; i++) {
+        prefetch_game(order[i]);
+    }
+    free(order);
+    return NULL;
+}
+
+void start_prefetch() {
+    int *order = malloc(sizeof(int) * num_games);
+    int queued[MAX_GAMES] = {0};
+    int count = 0;
+    pthread_t thread;
+
+    if (order == NULL) {
+        return;
+    }
+    for (int r = 0; r < num_recent; r++) {
+        for (int i = 0; i < num_games; i++) {
+            if (!queued[i] && strcmp(recent_games[r], games[i]) == 0) {
+                order[count++] = i;
+                queued[i] = 1;
+            }
+        }
+    }
+    for (int i = 0; i < num_games; i++) {
+        if (!queued[i]) {
+            order[count++] = i;
+        }
+    }
+    if (pthread_create(&thread, NULL, prefetch_games, order) != 0) {
+        free(order);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+int game_resident(int index) {
+    char path[256];
+    struct stat st;
+    int resident = 0;
+    launch_path(index, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            long page_size = sysconf(_SC_PAGESIZE);
+            size_t pages = (st.st_size + page_size - 1) / page_size;
+            unsigned char *vec = malloc(pages);
+            if (vec != NULL && mincore(addr, st.st_size, vec) == 0) {
+                resident = 1;
+                for (size_t i = 0; i < pages; i++) {
+                    if (!(vec[i] & 1)) {
+                        resident = 0;
+                        break;
+                    }
+                }
+            }
+            free(vec);
+            munmap(addr, st.st_size);
+        }
+    }
+    close(fd);
+    return resident;
+}
+
+void pin_selected_game() {
+    const char *pin = getenv("VGC_MLOCK");
+    char path[256];
+    struct stat st;
+
+    if (pin == NULL || strcmp(pin, "1") != 0) {
+        return;
+    }
+    if (pinned_game != NULL) {
+        munlock(pinned_game, pinned_size);
+        munmap(pinned_game, pinned_size);
+        pinned_game = NULL;
+    }
+    launch_path(current_game_index, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            if (mlock(addr, st.st_size) == 0) {
+                pinned_game = addr;
+                pinned_size = st.st_size;
+            } else {
+                munmap(addr, st.st_size);
+            }
+        }
+    }
+    close(fd);
+}
+
+/*
+ * Plugins are loaded from a private memfd copy so that rebuilding the .so in
+ * place never rewrites pages of the copy that is mapped; a changed mtime,
+ * inode or size makes the next launch load the new build.
+ */
+int snapshot_plugin(const char *path) {
+    char buffer[65536];
+    ssize_t nread;
+
+    int src = open(path, O_RDONLY);
+    if (src < 0) {
+        return -1;
+    }
+    int fd = memfd_create(path, MFD_CLOEXEC);
+    if (fd < 0) {
+        close(src);
+        return -1;
+    }
+    while ((nread = read(src, buffer, sizeof(buffer))) > 0) {
+        if (write(fd, buffer, nread) != nread) {
+            nread = -1;
+            break;
+        }
+    }
+    close(src);
+    if (nread < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+VgcGame *load_plugin(int index) {
+    char path[256];
+    char fd_path[64];
+    struct stat st;
+
+    plugin_path(index, path, sizeof(path));
+    if (stat(path, &st) != 0) {
+        return NULL;
+    }
+    if (plugin_handles[index] != NULL) {
+        struct stat *loaded = &plugin_stats[index];
+        if (st.st_ino == loaded->st_ino && st.st_size == loaded->st_size &&
+            st.st_mtim.tv_sec == loaded->st_mtim.tv_sec && st.st_mtim.tv_nsec == loaded->st_mtim.tv_nsec) {
+            return dlsym(plugin_handles[index], VGC_GAME_SYMBOL);
+        }
+    }
+
+    /* Snapshot before unloading the old copy so the new one gets a fresh fd path. */
+    int fd = snapshot_plugin(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (plugin_handles[index] != NULL) {
+        dlclose(plugin_handles[index]);
+        close(plugin_fds[index]);
+        plugin_handles[index] = NULL;
+    }
+    snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", fd);
+    void *handle = dlopen(fd_path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "Error loading %s: %s\n", path, dlerror());
+        close(fd);
+        return NULL;
+    }
+    VgcGame *game = dlsym(handle, VGC_GAME_SYMBOL);
+    if (game == NULL || game->abi_version != VGC_ABI_VERSION) {
+        fprintf(stderr, "Error loading %s: missing or incompatible %s\n", path, VGC_GAME_SYMBOL);
+        dlclose(handle);
+        close(fd);
+        return NULL;
+    }
+    plugin_handles[index] = handle;
+    plugin_fds[index] = fd;
+    plugin_stats[index] = st;
+    return game;
+}
+
 void draw_atari_logo() {
     printf(" ________   _________  ________   ______     ________     \n");
     printf("/_______/\\ /________/\\/_______/\\ /_____/\\  /_______/\\    \n");
@@ -117,13 +422,37 @@ void launch_game() {
         return;
     }
 
+    char launch_ns[32];
+    struct timespec now;
+    setenv("VGC_LAUNCH_WARM", game_resident(current_game_index) ? "1" : "0", 1);
+    save_recent(games[current_game_index]);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    snprintf(launch_ns, sizeof(launch_ns), "%lld", (long long)now.tv_sec * 1000000000LL + now.tv_nsec);
+    setenv("VGC_LAUNCH_NS", launch_ns, 1);
+
+    if (game_has_plugin[current_game_index]) {
+        VgcGame *game = load_plugin(current_game_index);
+        if (game != NULL) {
+            system("clear");
+            running_game = game;
+            vgc_run_game(game);
+            running_game = NULL;
+            start_prefetch();
+            return;
+        }
+    }
+    if (!game_has_executable[current_game_index]) {
+        return;
+    }
+
     system("clear");
     disableRawMode();
 
     game_pid = fork();
     if (game_pid == 0) {
         char game_exec[256];
-        snprintf(game_exec, sizeof(game_exec), "./%s%s", GAME_PREFIX, games[current_game_index]);
+        game_path(current_game_index, game_exec, sizeof(game_exec));
         execlp(game_exec, games[current_game_index], NULL);
         perror("Error launching game");
         exit(1);
@@ -131,6 +460,7 @@ void launch_game() {
         waitpid(game_pid, NULL, 0);
         game_pid = -1;
         enableRawMode();
+        start_prefetch();
     } else {
         perror("Fork failed");
         enableRawMode();
@@ -143,6 +473,9 @@ int main() {
     signal(SIGTERM, handle_signal);
 
     scan_games();
+    load_recent();
+    start_prefetch();
+    pin_selected_game();
 
     while (1) {
         draw_menu();
@@ -181,6 +514,7 @@ int main() {
                             current_game_index = 0;
                         }
                     }
+                    pin_selected_game();
                 }
             } else if (c == '\n' || c == '\r') {
                 if (selected_option == 0) {
@@ -0,0 +1,219 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#define OUTPUT_MAX_FRAME 65536
+#define OUTPUT_CLEAR "\033[H\033[2J"
+#define OUTPUT_RETRY_US 5000
+#define OUTPUT_SAMPLE_US 100000
+#define OUTPUT_PROBE_GAIN 1.25
+#define OUTPUT_UNPACED_RATE (64.0 * 1024 * 1024)
+
+typedef struct {
+    char data[OUTPUT_MAX_FRAME];
+    size_t length;
+} OutputFrame;
+
+static inline void frame_write(OutputFrame *frame, const void *data, size_t length) {
+    if (length > OUTPUT_MAX_FRAME - frame->length) {
+        length = OUTPUT_MAX_FRAME - frame->length;
+    }
+    memcpy(frame->data + frame->length, data, length);
+    frame->length += length;
+}
+
+static inline void frame_printf(OutputFrame *frame, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(frame->data + frame->length, OUTPUT_MAX_FRAME - frame->length, format, args);
+    va_end(args);
+    if (written > 0) {
+        frame->length += (size_t)written < OUTPUT_MAX_FRAME - frame->length ? (size_t)written
+                                                                            : OUTPUT_MAX_FRAME - frame->length - 1;
+    }
+}
+
+/*
+ * Frames are composed into `frame` and handed to the terminal with
+ * non-blocking writes. These go through a second open file description of
+ * stdout, so O_NONBLOCK never reaches the tty that stdin and the parent
+ * shell share; where stdout cannot be reopened (or is a regular file),
+ * blocking writes to fd 1 are only issued once poll() reports POLLOUT. While a previous frame is still partly unsent, or the
+ * tty output queue (TIOCOUTQ) holds more than half a frame, output_ready()
+ * refuses new frames so only the latest state is sent once the link drains.
+ * The drain rate measured while the link is backlogged caps the frame rate.
+ * Pacing keeps the queue from backing up again, so every sample in which it
+ * stayed empty raises the cap by OUTPUT_PROBE_GAIN until the link backs up
+ * or the cap is high enough to drop.
+ */
+typedef struct {
+    int active;
+    int fd;
+    int owns_fd;
+    OutputFrame frame;
+    char pending[OUTPUT_MAX_FRAME];
+    size_t pending_length;
+    size_t pending_offset;
+    size_t last_frame_length;
+    long long sent_total;
+    long long drained_mark;
+    long sample_time;
+    int backlogged;
+    double throughput;
+    long next_frame_time;
+    unsigned long frames;
+    unsigned long skipped;
+} Output;
+
+static Output output;
+
+static inline void output_start(long now) {
+    struct stat st;
+    memset(&output, 0, sizeof(output));
+    output.fd = -1;
+    if (fstat(STDOUT_FILENO, &st) == 0 && !S_ISREG(st.st_mode)) {
+        output.fd = open("/proc/self/fd/1", O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    }
+    output.owns_fd = output.fd >= 0;
+    if (!output.owns_fd) {
+        output.fd = STDOUT_FILENO;
+    }
+    output.sample_time = now;
+    output.active = 1;
+}
+
+static inline int output_queued() {
+    int queued = 0;
+    if (ioctl(output.fd, TIOCOUTQ, &queued) < 0) {
+        return 0;
+    }
+    return queued;
+}
+
+static inline ssize_t output_write(int timeout_ms) {
+    if (!output.owns_fd) {
+        struct pollfd writable = {output.fd, POLLOUT, 0};
+        if (poll(&writable, 1, timeout_ms) <= 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    return write(output.fd, output.pending + output.pending_offset, output.pending_length - output.pending_offset);
+}
+
+static inline void output_flush() {
+    while (output.pending_offset < output.pending_length) {
+        ssize_t written = output_write(0);
+        if (written <= 0) {
+            break;
+        }
+        output.pending_offset += written;
+        output.sent_total += written;
+    }
+}
+
+static inline void output_sample(long now, int queued) {
+    if (now - output.sample_time < OUTPUT_SAMPLE_US) {
+        return;
+    }
+    long long drained = output.sent_total - queued;
+    if (output.backlogged && drained > output.drained_mark) {
+        double rate = (drained - output.drained_mark) * 1000000.0 / (now - output.sample_time);
+        output.throughput = output.throughput > 0 ? output.throughput * 0.7 + rate * 0.3 : rate;
+    } else if (!output.backlogged && queued == 0 && output.throughput > 0) {
+        output.throughput *= OUTPUT_PROBE_GAIN;
+        if (output.throughput > OUTPUT_UNPACED_RATE) {
+            output.throughput = 0;
+        }
+    }
+    output.drained_mark = drained;
+    output.sample_time = now;
+    output.backlogged = queued > 0 || output.pending_offset < output.pending_length;
+}
+
+/* Whether a new frame may be rendered now; skipped frames are counted by the caller. */
+static inline int output_ready(long now) {
+    output_flush();
+    int queued = output_queued();
+    output_sample(now, queued);
+    if (output.pending_offset < output.pending_length) {
+        return 0;
+    }
+    if ((size_t)queued > output.last_frame_length / 2) {
+        return 0;
+    }
+    return now >= output.next_frame_time;
+}
+
+/* Microseconds until output_ready() is worth asking again. */
+static inline long output_retry_us(long now) {
+    if (output.pending_offset < output.pending_length || output_queued() > 0) {
+        return OUTPUT_RETRY_US;
+    }
+    return output.next_frame_time > now ? output.next_frame_time - now : 0;
+}
+
+static inline OutputFrame *output_begin() {
+    output.frame.length = 0;
+    frame_write(&output.frame, OUTPUT_CLEAR, strlen(OUTPUT_CLEAR));
+    return &output.frame;
+}
+
+static inline void output_present(long now) {
+    if (output.frame.length <= strlen(OUTPUT_CLEAR)) {
+        return;
+    }
+    memcpy(output.pending, output.frame.data, output.frame.length);
+    output.pending_length = output.frame.length;
+    output.pending_offset = 0;
+    output.last_frame_length = output.frame.length;
+    output.frames++;
+    output_flush();
+    if (output.throughput > 0) {
+        output.next_frame_time = now + (long)(output.last_frame_length * 1000000.0 / output.throughput);
+    }
+}
+
+/* Waits for whatever is left to be sent, closes the reopened stdout and optionally reports. */
+static inline void output_finish() {
+    if (!output.active) {
+        return;
+    }
+    output.active = 0;
+    while (output.pending_offset < output.pending_length) {
+        ssize_t written = output_write(-1);
+        if (written < 0 && errno == EAGAIN) {
+            struct pollfd writable = {output.fd, POLLOUT, 0};
+            poll(&writable, 1, -1);
+            continue;
+        }
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        output.pending_offset += written;
+    }
+    if (output.owns_fd) {
+        close(output.fd);
+    }
+
+    const char *stats = getenv("VGC_OUTPUT_STATS");
+    if (stats != NULL && strcmp(stats, "0") != 0) {
+        fprintf(stderr, "output: %lu frames sent, %lu skipped, link %.1f KB/s\n",
+                output.frames, output.skipped, output.throughput / 1024.0);
+    }
+}
+
+#endif
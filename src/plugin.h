@@ -0,0 +1,129 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/select.h>
+
+#include "input.h"
+#include "output.h"
+
+#define VGC_ABI_VERSION 5
+#define VGC_GAME_SYMBOL "vgc_game"
+#define VGC_EXPORT __attribute__((visibility("default")))
+
+#define VGC_REDRAW 1
+#define VGC_RESTART_TICK 2
+
+/*
+ * Entry points every game exports as `vgc_game`, either linked into its
+ * standalone executable or built with -DVGC_PLUGIN as game_<name>.so for
+ * the launcher to dlopen. tick() and input() return VGC_* flags; render()
+ * appends one whole screen to the frame, which the host paces to the link.
+ * A game that keeps its own timers sets deadline(), which returns the
+ * vgc_now_us() time of its next tick, instead of relying on tick_interval.
+ */
+typedef struct {
+    int abi_version;
+    const char *name;
+    long tick_interval;
+    long frame_interval;
+    int (*init)(void);
+    int (*tick)(void);
+    void (*render)(OutputFrame *frame, long since_tick);
+    int (*input)(const InputEvent *event);
+    void (*shutdown)(void);
+    int (*finished)(void);
+    long (*deadline)(void);
+} VgcGame;
+
+static inline long vgc_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static inline long vgc_next_tick(VgcGame *game, long last_tick) {
+    return game->deadline != NULL ? game->deadline() : last_tick + game->tick_interval;
+}
+
+/* Runs a game until it finishes; the terminal must already be in raw mode. */
+static inline void vgc_run_game(VgcGame *game) {
+    if (input_start() != 0) {
+        perror("Error starting input thread");
+        return;
+    }
+    if (game->init() != 0) {
+        input_stop();
+        return;
+    }
+    long last_tick = vgc_now_us();
+    long last_frame = last_tick;
+    int flags = VGC_REDRAW;
+    int frame_wanted = 0;
+
+    output_start(last_tick);
+    while (!game->finished()) {
+        long now = vgc_now_us();
+        if (now >= vgc_next_tick(game, last_tick)) {
+            flags |= game->tick();
+            last_tick = now;
+        }
+        if (game->finished()) {
+            break;
+        }
+        if ((flags & VGC_REDRAW) && frame_wanted) {
+            output.skipped++;
+        }
+        if ((flags & VGC_REDRAW) || (game->frame_interval > 0 && now - last_frame >= game->frame_interval)) {
+            frame_wanted = 1;
+        }
+        if (frame_wanted && output_ready(now)) {
+            game->render(output_begin(), now - last_tick);
+            output_present(now);
+            last_frame = now;
+            frame_wanted = 0;
+        }
+        flags = 0;
+
+        /* Rendering may have taken a while; measure the wait from now. */
+        now = vgc_now_us();
+        long timeout = vgc_next_tick(game, last_tick) - now;
+        if (frame_wanted) {
+            if (output_retry_us(now) < timeout) {
+                timeout = output_retry_us(now);
+            }
+        } else if (game->frame_interval > 0 && last_frame + game->frame_interval - now < timeout) {
+            timeout = last_frame + game->frame_interval - now;
+        }
+        if (timeout < 0) {
+            timeout = 0;
+        }
+
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(input.ready_fd, &read_fds);
+        struct timeval tv;
+        tv.tv_sec = timeout / 1000000L;
+        tv.tv_usec = timeout % 1000000L;
+        select(input.ready_fd + 1, &read_fds, NULL, NULL, &tv);
+
+        InputEvent event;
+        input_clear_ready();
+        while (input_pop(&event)) {
+            flags |= game->input(&event);
+            input_applied(&event);
+        }
+        if (flags & VGC_RESTART_TICK) {
+            last_tick = vgc_now_us();
+        }
+    }
+    game->render(output_begin(), vgc_now_us() - last_tick);
+    output_present(vgc_now_us());
+    output_finish();
+    game->shutdown();
+    input_stop();
+}
+
+#endif
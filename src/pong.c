@@ -8,13 +8,23 @@
 #include <sys/select.h>
 #include <sys/time.h>
 
+#include "savestate.h"
+#include "subpixel.h"
+#include "capture.h"
+#include "launchstat.h"
+#include "plugin.h"
+
 #define ROWS 15
 #define COLS 25
 #define TIME_INTERVAL 100000
+#define SAVE_SLOT "pong.sav"
+#define SAVE_ID SAVESTATE_ID('P', 'O', 'N', 'G')
 
 struct termios orig_termios;
 
 int game_over = 0;
+int quit = 0;
+int rewind_held = 0;
 int player_score = 0;
 int bot_score = 0;
 
@@ -28,10 +38,33 @@ typedef struct {
     int height;
 } Paddle;
 
+typedef struct {
+    Ball ball;
+    Paddle player_paddle;
+    Paddle bot_paddle;
+    int player_score;
+    int bot_score;
+    int bot_move_counter;
+} PongState;
+
 Ball ball;
+Ball previous_ball;
 Paddle player_paddle;
 Paddle bot_paddle;
+int bot_move_counter = 0;
+
+SaveStateRing history;
+
+RenderMode render_mode = RENDER_TEXT;
+SubpixelFrame frame;
+char frame_output[SUBPIXEL_MAX_WIDTH * SUBPIXEL_MAX_HEIGHT];
+int headless = 0;
+
+extern VgcGame vgc_game;
 
+void record_state();
+
+#ifndef VGC_PLUGIN
 void disableRawMode() {
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
 }
@@ -46,20 +79,17 @@ void enableRawMode() {
     raw.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
 }
+#endif
 
-void handle_exit() {
-    disableRawMode();
-    exit(0);
-}
-
-void signal_handler(int signum) {
-    handle_exit();
-}
-
-void init_game() {
-    enableRawMode();
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+int init_game() {
+    srand(time(NULL));
+    game_over = 0;
+    quit = 0;
+    rewind_held = 0;
+    player_score = 0;
+    bot_score = 0;
+    bot_move_counter = 0;
+    launchstat_begin();
 
     player_paddle.height = 5;
     player_paddle.y = (ROWS - player_paddle.height) / 2;
@@ -71,38 +101,151 @@ void init_game() {
     ball.y = ROWS / 2;
     ball.dx = (rand() % 2) ? 1 : -1;
     ball.dy = (rand() % 2) ? 1 : -1;
+    previous_ball = ball;
+
+    headless = capture_headless();
+    capture_start();
+
+    render_mode = render_mode_from_env();
+    vgc_game.frame_interval = TIME_INTERVAL;
+    if (render_mode != RENDER_TEXT) {
+        subpixel_init(&frame, (COLS + 2) * subpixel_cell_width(render_mode),
+                      (ROWS + 2) * subpixel_cell_height(render_mode));
+        vgc_game.frame_interval = TIME_INTERVAL / 4;
+    }
+
+    savestate_init(&history, sizeof(PongState));
+    record_state();
+    return 0;
+}
+
+void capture_state(PongState *state) {
+    memset(state, 0, sizeof(*state));
+    state->ball = ball;
+    state->player_paddle = player_paddle;
+    state->bot_paddle = bot_paddle;
+    state->player_score = player_score;
+    state->bot_score = bot_score;
+    state->bot_move_counter = bot_move_counter;
+}
+
+void restore_state(const PongState *state) {
+    ball = state->ball;
+    player_paddle = state->player_paddle;
+    bot_paddle = state->bot_paddle;
+    player_score = state->player_score;
+    bot_score = state->bot_score;
+    bot_move_counter = state->bot_move_counter;
+    previous_ball = ball;
+}
+
+void record_state() {
+    PongState state;
+    capture_state(&state);
+    savestate_push(&history, &state);
+}
+
+int rewind_state() {
+    PongState state;
+    if (savestate_rewind(&history, &state) != 0) {
+        return 0;
+    }
+    restore_state(&state);
+    return 1;
+}
+
+void quick_save() {
+    PongState state;
+    capture_state(&state);
+    savestate_write_slot(SAVE_SLOT, SAVE_ID, &state, sizeof(state));
 }
 
-void draw_game() {
-    system("clear");
+int valid_paddle(const Paddle *paddle) {
+    return paddle->height > 0 && paddle->height <= ROWS && paddle->y >= 0 && paddle->y + paddle->height <= ROWS;
+}
+
+/* Slot files are only checksummed, so reject anything the draw code could not index. */
+int valid_state(const PongState *state) {
+    const Ball *b = &state->ball;
+    return b->x >= 0 && b->x < COLS && b->y >= 0 && b->y < ROWS &&
+           (b->dx == 1 || b->dx == -1) && (b->dy == 1 || b->dy == -1) &&
+           valid_paddle(&state->player_paddle) && valid_paddle(&state->bot_paddle) &&
+           state->player_score >= 0 && state->bot_score >= 0;
+}
 
-    for (int i = 0; i < COLS + 2; i++) {
-        printf("#");
+int quick_load() {
+    PongState state;
+    if (savestate_read_slot(SAVE_SLOT, SAVE_ID, &state, sizeof(state)) == 0 && valid_state(&state)) {
+        restore_state(&state);
+        record_state();
+        return 1;
     }
-    printf("\n");
+    return 0;
+}
 
+void compose_screen(char screen[ROWS + 2][COLS + 2]) {
+    memset(screen, '#', (ROWS + 2) * (COLS + 2));
     for (int y = 0; y < ROWS; y++) {
-        printf("#");
         for (int x = 0; x < COLS; x++) {
+            char cell = ' ';
             if (x == ball.x && y == ball.y) {
-                printf("O");
+                cell = 'O';
             } else if (x == 0 && y >= player_paddle.y && y < player_paddle.y + player_paddle.height) {
-                printf("|");
+                cell = '|';
             } else if (x == COLS - 1 && y >= bot_paddle.y && y < bot_paddle.y + bot_paddle.height) {
-                printf("|");
-            } else {
-                printf(" ");
+                cell = '|';
             }
+            screen[y + 1][x + 1] = cell;
         }
-        printf("#\n");
     }
+}
 
-    for (int i = 0; i < COLS + 2; i++) {
-        printf("#");
+void draw_game_subpixel(OutputFrame *out, long since_tick) {
+    launchstat_first_frame("pong");
+    if (capture_enabled || headless) {
+        char screen[ROWS + 2][COLS + 2];
+        compose_screen(screen);
+        capture_frame(&screen[0][0], ROWS + 2, COLS + 2);
+        if (headless) {
+            return;
+        }
     }
-    printf("\n");
 
-    printf("Player: %d\tBOT: %d\n", player_score, bot_score);
+    int cw = subpixel_cell_width(render_mode);
+    int ch = subpixel_cell_height(render_mode);
+
+    subpixel_clear(&frame);
+    subpixel_outline(&frame, cw - 1, ch - 1, COLS * cw + 2, ROWS * ch + 2);
+    subpixel_fill_rect(&frame, cw, (player_paddle.y + 1) * ch, cw / 2 + 1, player_paddle.height * ch);
+    subpixel_fill_rect(&frame, COLS * cw + cw - (cw / 2 + 1), (bot_paddle.y + 1) * ch, cw / 2 + 1, bot_paddle.height * ch);
+
+    int ball_x = (ball.x + 1) * cw;
+    int ball_y = (ball.y + 1) * ch;
+    if (abs(ball.x - previous_ball.x) <= 1 && abs(ball.y - previous_ball.y) <= 1 && since_tick < TIME_INTERVAL) {
+        ball_x = (previous_ball.x + 1) * cw + (ball.x - previous_ball.x) * cw * since_tick / TIME_INTERVAL;
+        ball_y = (previous_ball.y + 1) * ch + (ball.y - previous_ball.y) * ch * since_tick / TIME_INTERVAL;
+    }
+    subpixel_fill_rect(&frame, ball_x, ball_y + ch / 4, cw, ch / 2);
+
+    frame_write(out, frame_output, subpixel_pack(&frame, render_mode, frame_output, sizeof(frame_output)));
+    frame_printf(out, "Player: %d\tBOT: %d\n", player_score, bot_score);
+}
+
+void draw_game(OutputFrame *out) {
+    char screen[ROWS + 2][COLS + 2];
+    compose_screen(screen);
+    launchstat_first_frame("pong");
+    capture_frame(&screen[0][0], ROWS + 2, COLS + 2);
+    if (headless) {
+        return;
+    }
+
+    for (int y = 0; y < ROWS + 2; y++) {
+        frame_write(out, screen[y], COLS + 2);
+        frame_write(out, "\n", 1);
+    }
+
+    frame_printf(out, "Player: %d\tBOT: %d\n", player_score, bot_score);
 }
 
 void update_ball() {
@@ -147,7 +290,6 @@ void update_ball() {
 }
 
 void update_bot() {
-    static int bot_move_counter = 0;
     bot_move_counter++;
 
     if (bot_move_counter >= 2) {
@@ -165,56 +307,103 @@ void update_bot() {
     }
 }
 
-int main() {
-    srand(time(NULL));
-    init_game();
-
-    struct timeval last_time, current_time;
-    gettimeofday(&last_time, NULL);
+int tick_game() {
+    if (rewind_held) {
+        return rewind_state() ? VGC_REDRAW : 0;
+    }
+    previous_ball = ball;
+    update_ball();
+    update_bot();
+    record_state();
+    return VGC_REDRAW;
+}
 
-    while (!game_over) {
-        draw_game();
+void render_game(OutputFrame *out, long since_tick) {
+    if (render_mode == RENDER_TEXT) {
+        draw_game(out);
+    } else {
+        draw_game_subpixel(out, since_tick);
+    }
+}
 
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
+int handle_input(const InputEvent *event) {
+    char c = tolower(event->key);
+    if (!event->pressed) {
+        if (c == 'r') {
+            rewind_held = 0;
+        }
+        return 0;
+    }
 
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 100000;
+    if (c == 'q') {
+        quit = 1;
+    } else if (c == 'w') {
+        if (player_paddle.y > 0) {
+            player_paddle.y--;
+        }
+    } else if (c == 's') {
+        if (player_paddle.y + player_paddle.height < ROWS) {
+            player_paddle.y++;
+        }
+    } else if (c == 'r') {
+        rewind_held = event->source == INPUT_SOURCE_EVDEV;
+        if (rewind_state()) {
+            return VGC_REDRAW | VGC_RESTART_TICK;
+        }
+        return 0;
+    } else if (c == 'k') {
+        quick_save();
+        return 0;
+    } else if (c == 'l') {
+        return quick_load() ? VGC_REDRAW : 0;
+    } else {
+        return 0;
+    }
+    return VGC_REDRAW;
+}
 
-        int select_result = select(STDIN_FILENO + 1, &read_fds, NULL, NULL, &tv);
+void shutdown_game() {
+    capture_stop();
+}
 
-        if (select_result > 0) {
-            char c;
-            read(STDIN_FILENO, &c, 1);
+int game_finished() {
+    return game_over || quit;
+}
 
-            c = tolower(c);
+VGC_EXPORT VgcGame vgc_game = {
+    VGC_ABI_VERSION,
+    "pong",
+    TIME_INTERVAL,
+    TIME_INTERVAL,
+    init_game,
+    tick_game,
+    render_game,
+    handle_input,
+    shutdown_game,
+    game_finished,
+    NULL
+};
+
+#ifndef VGC_PLUGIN
+void handle_exit() {
+    output_finish();
+    shutdown_game();
+    disableRawMode();
+    exit(0);
+}
 
-            if (c == 'q') {
-                handle_exit();
-            } else if (c == 'w') {
-                if (player_paddle.y > 0) {
-                    player_paddle.y--;
-                }
-            } else if (c == 's') {
-                if (player_paddle.y + player_paddle.height < ROWS) {
-                    player_paddle.y++;
-                }
-            }
-        }
+void signal_handler(int signum) {
+    handle_exit();
+}
 
-        gettimeofday(&current_time, NULL);
-        long elapsed = (current_time.tv_sec - last_time.tv_sec) * 1000000L +
-                       (current_time.tv_usec - last_time.tv_usec);
+int main() {
+    enableRawMode();
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
 
-        if (elapsed >= TIME_INTERVAL) {
-            update_ball();
-            update_bot();
-            last_time = current_time;
-        }
-    }
+    vgc_run_game(&vgc_game);
 
-    handle_exit();
+    disableRawMode();
     return 0;
 }
+#endif
@@ -0,0 +1,276 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SAVESTATE_MAGIC "VGCS"
+#define SAVESTATE_VERSION 1
+#define SAVESTATE_HISTORY 4096
+#define SAVESTATE_KEYFRAME_INTERVAL 32
+#define SAVESTATE_POOL_SIZE (256 * 1024)
+#define SAVESTATE_MAX_STATE 4096
+
+#define SAVESTATE_MAX_ENCODED(n) ((n) + ((n) + 1) / 2 + 1)
+
+#define SAVESTATE_ID(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+/*
+ * Every snapshot is stored as a run-length encoded XOR against the keyframe
+ * that starts its group; keyframes themselves are encoded against zero.
+ * Token 0x80|n skips n+1 unchanged bytes, token n is followed by n+1 XOR bytes.
+ * The worst case, bytes alternating between changed and unchanged, costs
+ * three output bytes for every two input bytes (SAVESTATE_MAX_ENCODED).
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    unsigned long keyframe;
+} SaveStateEntry;
+
+typedef struct {
+    size_t state_size;
+    unsigned long head;
+    unsigned long tail;
+    unsigned long cached_keyframe;
+    int cache_valid;
+    uint32_t pool_head;
+    SaveStateEntry entries[SAVESTATE_HISTORY];
+    unsigned char keyframe_cache[SAVESTATE_MAX_STATE];
+    unsigned char pool[SAVESTATE_POOL_SIZE];
+} SaveStateRing;
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t game_id;
+    uint32_t state_size;
+    uint32_t checksum;
+} SaveStateHeader;
+
+static inline int savestate_init(SaveStateRing *ring, size_t state_size) {
+    if (state_size == 0 || state_size > SAVESTATE_MAX_STATE) {
+        return -1;
+    }
+    ring->state_size = state_size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->cache_valid = 0;
+    ring->pool_head = 0;
+    return 0;
+}
+
+static inline size_t savestate_count(const SaveStateRing *ring) {
+    return ring->head - ring->tail;
+}
+
+static inline size_t savestate_encode(const unsigned char *ref, const unsigned char *cur, size_t n,
+                               unsigned char *out) {
+    size_t i = 0, len = 0;
+    while (i < n) {
+        size_t run = 0;
+        while (i + run < n && run < 128 && (ref ? ref[i + run] : 0) == cur[i + run]) {
+            run++;
+        }
+        if (run > 0) {
+            out[len++] = 0x80 | (unsigned char)(run - 1);
+            i += run;
+            continue;
+        }
+        size_t start = len++;
+        size_t lit = 0;
+        while (i < n && lit < 128 && (ref ? ref[i] : 0) != cur[i]) {
+            out[len++] = (ref ? ref[i] : 0) ^ cur[i];
+            i++;
+            lit++;
+        }
+        out[start] = (unsigned char)(lit - 1);
+    }
+    return len;
+}
+
+/* Stops at the end of `state` or `delta`, so a damaged delta cannot write past either. */
+static inline void savestate_apply(unsigned char *state, size_t size, const unsigned char *delta, size_t len) {
+    size_t pos = 0;
+    for (size_t i = 0; i < len && pos < size;) {
+        unsigned char token = delta[i++];
+        size_t count = (size_t)(token & 0x7f) + 1;
+        if (token & 0x80) {
+            pos += count;
+        } else {
+            for (size_t j = 0; j < count && i < len && pos < size; j++) {
+                state[pos++] ^= delta[i++];
+            }
+        }
+    }
+}
+
+static inline SaveStateEntry *savestate_entry(SaveStateRing *ring, unsigned long index) {
+    return &ring->entries[index % SAVESTATE_HISTORY];
+}
+
+static inline void savestate_load_keyframe(SaveStateRing *ring, unsigned long keyframe) {
+    if (ring->cache_valid && ring->cached_keyframe == keyframe) {
+        return;
+    }
+    SaveStateEntry *entry = savestate_entry(ring, keyframe);
+    memset(ring->keyframe_cache, 0, ring->state_size);
+    savestate_apply(ring->keyframe_cache, ring->state_size, ring->pool + entry->offset, entry->length);
+    ring->cached_keyframe = keyframe;
+    ring->cache_valid = 1;
+}
+
+static inline int savestate_overlaps(const SaveStateEntry *entry, uint32_t start, uint32_t end) {
+    return entry->offset < end && start < entry->offset + entry->length;
+}
+
+static inline void savestate_evict_group(SaveStateRing *ring) {
+    unsigned long keyframe = savestate_entry(ring, ring->tail)->keyframe;
+    while (ring->tail < ring->head && savestate_entry(ring, ring->tail)->keyframe == keyframe) {
+        ring->tail++;
+    }
+    if (ring->cache_valid && ring->cached_keyframe == keyframe) {
+        ring->cache_valid = 0;
+    }
+}
+
+static inline int savestate_tail_overlaps(SaveStateRing *ring, uint32_t start, uint32_t end) {
+    unsigned long keyframe = savestate_entry(ring, ring->tail)->keyframe;
+    for (unsigned long i = ring->tail; i < ring->head; i++) {
+        SaveStateEntry *entry = savestate_entry(ring, i);
+        if (entry->keyframe != keyframe) {
+            break;
+        }
+        if (savestate_overlaps(entry, start, end)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline void savestate_push(SaveStateRing *ring, const void *state) {
+    size_t max_len = SAVESTATE_MAX_ENCODED(ring->state_size);
+    int keyframe = ring->head == ring->tail ||
+                   ring->head - savestate_entry(ring, ring->head - 1)->keyframe >= SAVESTATE_KEYFRAME_INTERVAL;
+
+    if (savestate_count(ring) >= SAVESTATE_HISTORY) {
+        savestate_evict_group(ring);
+    }
+    uint32_t start = ring->pool_head;
+    if (start + max_len > SAVESTATE_POOL_SIZE) {
+        start = 0;
+    }
+    while (ring->tail < ring->head && savestate_tail_overlaps(ring, start, start + max_len)) {
+        savestate_evict_group(ring);
+    }
+    if (ring->head == ring->tail || savestate_entry(ring, ring->head - 1)->keyframe < ring->tail) {
+        keyframe = 1;
+    }
+
+    SaveStateEntry *entry = savestate_entry(ring, ring->head);
+    entry->offset = start;
+    if (keyframe) {
+        entry->keyframe = ring->head;
+        entry->length = savestate_encode(NULL, state, ring->state_size, ring->pool + start);
+        memcpy(ring->keyframe_cache, state, ring->state_size);
+        ring->cached_keyframe = ring->head;
+        ring->cache_valid = 1;
+    } else {
+        entry->keyframe = savestate_entry(ring, ring->head - 1)->keyframe;
+        savestate_load_keyframe(ring, entry->keyframe);
+        entry->length = savestate_encode(ring->keyframe_cache, state, ring->state_size,
+                                         ring->pool + start);
+    }
+    ring->pool_head = start + entry->length;
+    ring->head++;
+}
+
+/* Decodes the snapshot taken `age` pushes ago (0 is the newest). */
+static inline int savestate_get(SaveStateRing *ring, size_t age, void *out) {
+    if (age >= savestate_count(ring)) {
+        return -1;
+    }
+    SaveStateEntry *entry = savestate_entry(ring, ring->head - 1 - age);
+    savestate_load_keyframe(ring, entry->keyframe);
+    memcpy(out, ring->keyframe_cache, ring->state_size);
+    if (entry->keyframe != ring->head - 1 - age) {
+        savestate_apply(out, ring->state_size, ring->pool + entry->offset, entry->length);
+    }
+    return 0;
+}
+
+/* Drops the newest snapshot and decodes the one before it into `out`. */
+static inline int savestate_rewind(SaveStateRing *ring, void *out) {
+    if (savestate_count(ring) < 2) {
+        return -1;
+    }
+    ring->head--;
+    ring->pool_head = savestate_entry(ring, ring->head)->offset;
+    if (ring->cache_valid && ring->cached_keyframe == ring->head) {
+        ring->cache_valid = 0;
+    }
+    return savestate_get(ring, 0, out);
+}
+
+static inline uint32_t savestate_checksum(const unsigned char *data, size_t n) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static inline int savestate_write_slot(const char *path, uint32_t game_id, const void *state, size_t size) {
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    SaveStateHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAVESTATE_MAGIC, 4);
+    header.version = SAVESTATE_VERSION;
+    header.game_id = game_id;
+    header.state_size = (uint32_t)size;
+    header.checksum = savestate_checksum(state, size);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(state, size, 1, file) == 1;
+    if (fclose(file) != 0 || !ok) {
+        remove(tmp_path);
+        return -1;
+    }
+    return rename(tmp_path, path);
+}
+
+static inline int savestate_read_slot(const char *path, uint32_t game_id, void *state, size_t size) {
+    unsigned char buffer[SAVESTATE_MAX_STATE];
+    SaveStateHeader header;
+
+    if (size > sizeof(buffer)) {
+        return -1;
+    }
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    int ok = fread(&header, sizeof(header), 1, file) == 1 &&
+             memcmp(header.magic, SAVESTATE_MAGIC, 4) == 0 &&
+             header.version == SAVESTATE_VERSION &&
+             header.game_id == game_id &&
+             header.state_size == size &&
+             fread(buffer, size, 1, file) == 1 &&
+             savestate_checksum(buffer, size) == header.checksum;
+    fclose(file);
+    if (!ok) {
+        return -1;
+    }
+    memcpy(state, buffer, size);
+    return 0;
+}
+
+#endif
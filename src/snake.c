@@ -9,9 +9,17 @@
 #include <sys/time.h>
 #include <sys/select.h>
 
+#include "savestate.h"
+#include "subpixel.h"
+#include "capture.h"
+#include "launchstat.h"
+#include "plugin.h"
+
 #define ROWS 15
 #define COLS 15
 #define TIME_INTERVAL 200000
+#define SAVE_SLOT "snake.sav"
+#define SAVE_ID SAVESTATE_ID('S', 'N', 'A', 'K')
 
 struct termios orig_termios;
 
@@ -21,13 +29,38 @@ typedef struct SnakeNode {
     struct SnakeNode* next;
 } SnakeNode;
 
+typedef struct {
+    int x;
+    int y;
+} SnakeSegment;
+
+typedef struct {
+    int length;
+    int bait_x, bait_y;
+    char direction;
+    char next_direction;
+    SnakeSegment body[ROWS * COLS];
+} SnakeState;
+
 SnakeNode* snake_head = NULL;
 SnakeNode* snake_tail = NULL;
 int bait_x, bait_y;
 char direction = 'd';
 char next_direction = 'd';
 int game_over = 0;
+int quit = 0;
+int rewind_held = 0;
+
+SaveStateRing history;
 
+RenderMode render_mode = RENDER_TEXT;
+SubpixelFrame frame;
+char frame_output[SUBPIXEL_MAX_WIDTH * SUBPIXEL_MAX_HEIGHT];
+int headless = 0;
+
+void record_state();
+
+#ifndef VGC_PLUGIN
 void disableRawMode() {
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
 }
@@ -42,27 +75,28 @@ void enableRawMode() {
     raw.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
 }
+#endif
 
-void handle_exit() {
-    disableRawMode();
+void free_snake() {
     SnakeNode* current = snake_head;
     while (current != NULL) {
         SnakeNode* temp = current;
         current = current->next;
         free(temp);
     }
-    exit(0);
+    snake_head = NULL;
+    snake_tail = NULL;
 }
 
-void signal_handler(int signum) {
-    handle_exit();
-}
-
-void init_game() {
-    enableRawMode();
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+int init_game() {
     srand(time(NULL));
+    free_snake();
+    direction = 'd';
+    next_direction = 'd';
+    game_over = 0;
+    quit = 0;
+    rewind_held = 0;
+    launchstat_begin();
     snake_head = (SnakeNode*)malloc(sizeof(SnakeNode));
     snake_head->x = COLS / 2;
     snake_head->y = ROWS / 2;
@@ -72,6 +106,103 @@ void init_game() {
         bait_x = rand() % COLS;
         bait_y = rand() % ROWS;
     } while (bait_x == snake_head->x && bait_y == snake_head->y);
+    headless = capture_headless();
+    capture_start();
+    render_mode = render_mode_from_env();
+    if (render_mode != RENDER_TEXT) {
+        subpixel_init(&frame, COLS * subpixel_cell_width(render_mode), ROWS * subpixel_cell_height(render_mode));
+    }
+    savestate_init(&history, sizeof(SnakeState));
+    record_state();
+    return 0;
+}
+
+void capture_state(SnakeState* state) {
+    memset(state, 0, sizeof(*state));
+    state->bait_x = bait_x;
+    state->bait_y = bait_y;
+    state->direction = direction;
+    state->next_direction = next_direction;
+    SnakeNode* current = snake_head;
+    while (current != NULL && state->length < ROWS * COLS) {
+        state->body[state->length].x = current->x;
+        state->body[state->length].y = current->y;
+        state->length++;
+        current = current->next;
+    }
+}
+
+void restore_state(const SnakeState* state) {
+    free_snake();
+    for (int i = 0; i < state->length; i++) {
+        SnakeNode* node = (SnakeNode*)malloc(sizeof(SnakeNode));
+        node->x = state->body[i].x;
+        node->y = state->body[i].y;
+        node->next = NULL;
+        if (snake_tail == NULL) {
+            snake_head = node;
+        } else {
+            snake_tail->next = node;
+        }
+        snake_tail = node;
+    }
+    bait_x = state->bait_x;
+    bait_y = state->bait_y;
+    direction = state->direction;
+    next_direction = state->next_direction;
+}
+
+void record_state() {
+    SnakeState state;
+    capture_state(&state);
+    savestate_push(&history, &state);
+}
+
+int rewind_state() {
+    SnakeState state;
+    if (savestate_rewind(&history, &state) != 0) {
+        return 0;
+    }
+    restore_state(&state);
+    return 1;
+}
+
+void quick_save() {
+    SnakeState state;
+    capture_state(&state);
+    savestate_write_slot(SAVE_SLOT, SAVE_ID, &state, sizeof(state));
+}
+
+int on_board(int x, int y) {
+    return x >= 0 && x < COLS && y >= 0 && y < ROWS;
+}
+
+int valid_direction(char c) {
+    return c == 'w' || c == 'a' || c == 's' || c == 'd';
+}
+
+/* Slot files are only checksummed, so reject anything draw_game() could not index. */
+int valid_state(const SnakeState *state) {
+    if (state->length <= 0 || state->length > ROWS * COLS || !on_board(state->bait_x, state->bait_y) ||
+        !valid_direction(state->direction) || !valid_direction(state->next_direction)) {
+        return 0;
+    }
+    for (int i = 0; i < state->length; i++) {
+        if (!on_board(state->body[i].x, state->body[i].y)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int quick_load() {
+    SnakeState state;
+    if (savestate_read_slot(SAVE_SLOT, SAVE_ID, &state, sizeof(state)) == 0 && valid_state(&state)) {
+        restore_state(&state);
+        record_state();
+        return 1;
+    }
+    return 0;
 }
 
 void place_bait() {
@@ -91,7 +222,12 @@ void place_bait() {
     }
 }
 
-void draw_game() {
+void draw_grid_subpixel(OutputFrame *out, char cells[ROWS][COLS]) {
+    subpixel_draw_cells(&frame, render_mode, &cells[0][0], ROWS, COLS, '.', 'X');
+    frame_write(out, frame_output, subpixel_pack(&frame, render_mode, frame_output, sizeof(frame_output)));
+}
+
+void draw_game(OutputFrame *out) {
     char grid[ROWS][COLS];
     memset(grid, '.', sizeof(grid));
     grid[bait_y][bait_x] = 'X';
@@ -103,12 +239,18 @@ void draw_game() {
             grid[current->y][current->x] = '#';
         current = current->next;
     }
-    system("clear");
+    launchstat_first_frame("snake");
+    capture_frame(&grid[0][0], ROWS, COLS);
+    if (headless) {
+        return;
+    }
+    if (render_mode != RENDER_TEXT) {
+        draw_grid_subpixel(out, grid);
+        return;
+    }
     for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            printf("%c", grid[i][j]);
-        }
-        printf("\n");
+        frame_write(out, grid[i], COLS);
+        frame_write(out, "\n", 1);
     }
 }
 
@@ -153,36 +295,87 @@ void update_game() {
     }
 }
 
-int main() {
-    init_game();
-    struct timeval last_time, current_time;
-    gettimeofday(&last_time, NULL);
-    while (!game_over) {
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
-        if (select(STDIN_FILENO + 1, &read_fds, NULL, NULL, &tv) > 0) {
-            char c;
-            read(STDIN_FILENO, &c, 1);
-            c = tolower(c);
-            if (c == 'q') {
-                handle_exit();
-            } else if (c == 'w' || c == 'a' || c == 's' || c == 'd') {
-                next_direction = c;
-            }
+int tick_game() {
+    if (rewind_held) {
+        return rewind_state() ? VGC_REDRAW : 0;
+    }
+    update_game();
+    record_state();
+    return VGC_REDRAW;
+}
+
+void render_game(OutputFrame *out, long since_tick) {
+    draw_game(out);
+}
+
+int handle_input(const InputEvent *event) {
+    char c = tolower(event->key);
+    if (!event->pressed) {
+        if (c == 'r') {
+            rewind_held = 0;
+        }
+        return 0;
+    }
+    if (c == 'q') {
+        quit = 1;
+    } else if (c == 'w' || c == 'a' || c == 's' || c == 'd') {
+        next_direction = c;
+    } else if (c == 'r') {
+        rewind_held = event->source == INPUT_SOURCE_EVDEV;
+        if (rewind_state()) {
+            return VGC_REDRAW | VGC_RESTART_TICK;
         }
-        gettimeofday(&current_time, NULL);
-        long elapsed = (current_time.tv_sec - last_time.tv_sec) * 1000000L +
-                       (current_time.tv_usec - last_time.tv_usec);
-        if (elapsed >= TIME_INTERVAL) {
-            update_game();
-            draw_game();
-            last_time = current_time;
+    } else if (c == 'k') {
+        quick_save();
+    } else if (c == 'l') {
+        if (quick_load()) {
+            return VGC_REDRAW;
         }
     }
+    return 0;
+}
+
+void shutdown_game() {
+    capture_stop();
+    free_snake();
+}
+
+int game_finished() {
+    return game_over || quit;
+}
+
+VGC_EXPORT VgcGame vgc_game = {
+    VGC_ABI_VERSION,
+    "snake",
+    TIME_INTERVAL,
+    0,
+    init_game,
+    tick_game,
+    render_game,
+    handle_input,
+    shutdown_game,
+    game_finished,
+    NULL
+};
+
+#ifndef VGC_PLUGIN
+void handle_exit() {
+    output_finish();
+    shutdown_game();
+    disableRawMode();
+    exit(0);
+}
+
+void signal_handler(int signum) {
     handle_exit();
+}
+
+int main() {
+    enableRawMode();
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    vgc_run_game(&vgc_game);
+    disableRawMode();
     return 0;
 }
+#endif
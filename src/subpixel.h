@@ -0,0 +1,213 @@
+#ifndef SUBPIXEL_H
+#define SUBPIXEL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUBPIXEL_MAX_WIDTH 512
+#define SUBPIXEL_MAX_HEIGHT 256
+#define SUBPIXEL_WORDS (SUBPIXEL_MAX_WIDTH / 64)
+
+typedef enum {
+    RENDER_TEXT,
+    RENDER_BRAILLE,
+    RENDER_HALFBLOCK
+} RenderMode;
+
+/* One bit per subpixel, bit 0 of word 0 is the leftmost subpixel of a row. */
+typedef struct {
+    int width;
+    int height;
+    uint64_t bits[SUBPIXEL_MAX_HEIGHT][SUBPIXEL_WORDS];
+} SubpixelFrame;
+
+static uint32_t braille_row_lut[4][256];
+static uint16_t halfblock_spread_lut[256];
+static char braille_utf8[256][3];
+/* Always copied three bytes at a time; only halfblock_glyph_len of them count. */
+static const char halfblock_glyphs[4][3] = {" ", "\xe2\x96\x80", "\xe2\x96\x84", "\xe2\x96\x88"};
+static const unsigned char halfblock_glyph_len[4] = {1, 3, 3, 3};
+static int subpixel_tables_ready = 0;
+
+static inline void subpixel_build_tables() {
+    static const uint8_t left_dots[4] = {0x01, 0x02, 0x04, 0x40};
+    static const uint8_t right_dots[4] = {0x08, 0x10, 0x20, 0x80};
+
+    for (int row = 0; row < 4; row++) {
+        for (int byte = 0; byte < 256; byte++) {
+            uint32_t cells = 0;
+            for (int cell = 0; cell < 4; cell++) {
+                uint32_t dots = 0;
+                if (byte & (1 << (cell * 2))) dots |= left_dots[row];
+                if (byte & (1 << (cell * 2 + 1))) dots |= right_dots[row];
+                cells |= dots << (cell * 8);
+            }
+            braille_row_lut[row][byte] = cells;
+        }
+    }
+    for (int byte = 0; byte < 256; byte++) {
+        uint16_t spread = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if (byte & (1 << bit)) spread |= (uint16_t)(1 << (bit * 2));
+        }
+        halfblock_spread_lut[byte] = spread;
+
+        int code = 0x2800 + byte;
+        braille_utf8[byte][0] = (char)(0xe0 | (code >> 12));
+        braille_utf8[byte][1] = (char)(0x80 | ((code >> 6) & 0x3f));
+        braille_utf8[byte][2] = (char)(0x80 | (code & 0x3f));
+    }
+    subpixel_tables_ready = 1;
+}
+
+static inline RenderMode render_mode_from_env() {
+    const char *mode = getenv("VGC_RENDERER");
+    if (mode != NULL && strcmp(mode, "braille") == 0) return RENDER_BRAILLE;
+    if (mode != NULL && strcmp(mode, "halfblock") == 0) return RENDER_HALFBLOCK;
+    return RENDER_TEXT;
+}
+
+/* Subpixels covered by one terminal character in the given mode. */
+static inline int subpixel_cell_width(RenderMode mode) {
+    return mode == RENDER_BRAILLE ? 2 : 1;
+}
+
+static inline int subpixel_cell_height(RenderMode mode) {
+    return mode == RENDER_BRAILLE ? 4 : 2;
+}
+
+static inline void subpixel_init(SubpixelFrame *frame, int width, int height) {
+    if (!subpixel_tables_ready) {
+        subpixel_build_tables();
+    }
+    frame->width = width < SUBPIXEL_MAX_WIDTH ? width : SUBPIXEL_MAX_WIDTH;
+    frame->height = height < SUBPIXEL_MAX_HEIGHT ? height : SUBPIXEL_MAX_HEIGHT;
+    memset(frame->bits, 0, sizeof(frame->bits));
+}
+
+static inline void subpixel_clear(SubpixelFrame *frame) {
+    memset(frame->bits, 0, sizeof(frame->bits));
+}
+
+static inline void subpixel_fill_rect(SubpixelFrame *frame, int x, int y, int w, int h) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > frame->width) w = frame->width - x;
+    if (y + h > frame->height) h = frame->height - y;
+    if (w <= 0 || h <= 0) return;
+
+    int first = x / 64, last = (x + w - 1) / 64;
+    for (int word = first; word <= last; word++) {
+        int lo = word == first ? x % 64 : 0;
+        int hi = word == last ? (x + w - 1) % 64 : 63;
+        uint64_t mask = (hi == 63 ? ~0ULL : ((1ULL << (hi + 1)) - 1)) & ~((1ULL << lo) - 1);
+        for (int row = y; row < y + h; row++) {
+            frame->bits[row][word] |= mask;
+        }
+    }
+}
+
+static inline void subpixel_set(SubpixelFrame *frame, int x, int y) {
+    if (x >= 0 && x < frame->width && y >= 0 && y < frame->height) {
+        frame->bits[y][x / 64] |= 1ULL << (x % 64);
+    }
+}
+
+static inline void subpixel_outline(SubpixelFrame *frame, int x, int y, int w, int h) {
+    subpixel_fill_rect(frame, x, y, w, 1);
+    subpixel_fill_rect(frame, x, y + h - 1, w, 1);
+    subpixel_fill_rect(frame, x, y, 1, h);
+    subpixel_fill_rect(frame, x + w - 1, y, 1, h);
+}
+
+/*
+ * Draws a row-major grid of text cells: `empty` cells become one dot in
+ * braille mode, `small` cells (0 for none) a half-height block and any other
+ * character a full cell.
+ */
+static inline void subpixel_draw_cells(SubpixelFrame *frame, RenderMode mode, const char *cells,
+                                       int rows, int cols, char empty, char small) {
+    int cw = subpixel_cell_width(mode);
+    int ch = subpixel_cell_height(mode);
+    subpixel_clear(frame);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            char cell = cells[i * cols + j];
+            if (cell == empty) {
+                if (mode == RENDER_BRAILLE) {
+                    subpixel_set(frame, j * cw, i * ch + ch / 2);
+                }
+            } else if (small && cell == small) {
+                subpixel_fill_rect(frame, j * cw, i * ch + ch / 4, cw, ch / 2);
+            } else {
+                subpixel_fill_rect(frame, j * cw, i * ch, cw, ch);
+            }
+        }
+    }
+}
+
+static inline size_t subpixel_pack_braille(const SubpixelFrame *frame, char *out, size_t capacity) {
+    static const uint64_t zero_row[SUBPIXEL_WORDS];
+    int cols = (frame->width + 1) / 2;
+    size_t len = 0;
+
+    for (int y = 0; y < frame->height; y += 4) {
+        const uint64_t *rows[4];
+        for (int r = 0; r < 4; r++) {
+            rows[r] = y + r < frame->height ? frame->bits[y + r] : zero_row;
+        }
+        if (len + (size_t)cols * 3 + 1 > capacity) break;
+        int col = 0;
+        for (int word = 0; col < cols; word++) {
+            uint64_t w0 = rows[0][word], w1 = rows[1][word], w2 = rows[2][word], w3 = rows[3][word];
+            for (int byte = 0; byte < 8 && col < cols; byte++) {
+                uint32_t cells = braille_row_lut[0][w0 & 0xff] | braille_row_lut[1][w1 & 0xff] |
+                                 braille_row_lut[2][w2 & 0xff] | braille_row_lut[3][w3 & 0xff];
+                w0 >>= 8; w1 >>= 8; w2 >>= 8; w3 >>= 8;
+                for (int cell = 0; cell < 4 && col < cols; cell++, col++) {
+                    memcpy(out + len, braille_utf8[cells & 0xff], 3);
+                    len += 3;
+                    cells >>= 8;
+                }
+            }
+        }
+        out[len++] = '\n';
+    }
+    return len;
+}
+
+static inline size_t subpixel_pack_halfblock(const SubpixelFrame *frame, char *out, size_t capacity) {
+    static const uint64_t zero_row[SUBPIXEL_WORDS];
+    size_t len = 0;
+
+    for (int y = 0; y < frame->height; y += 2) {
+        const uint64_t *top = frame->bits[y];
+        const uint64_t *bottom = y + 1 < frame->height ? frame->bits[y + 1] : zero_row;
+        if (len + (size_t)frame->width * 3 + 1 > capacity) break;
+        int col = 0;
+        for (int word = 0; col < frame->width; word++) {
+            uint64_t t = top[word], b = bottom[word];
+            for (int byte = 0; byte < 8 && col < frame->width; byte++) {
+                uint32_t pairs = halfblock_spread_lut[t & 0xff] | (halfblock_spread_lut[b & 0xff] << 1);
+                t >>= 8; b >>= 8;
+                for (int cell = 0; cell < 8 && col < frame->width; cell++, col++) {
+                    memcpy(out + len, halfblock_glyphs[pairs & 3], 3);
+                    len += halfblock_glyph_len[pairs & 3];
+                    pairs >>= 2;
+                }
+            }
+        }
+        out[len++] = '\n';
+    }
+    return len;
+}
+
+static inline size_t subpixel_pack(const SubpixelFrame *frame, RenderMode mode, char *out, size_t capacity) {
+    if (mode == RENDER_HALFBLOCK) {
+        return subpixel_pack_halfblock(frame, out, capacity);
+    }
+    return subpixel_pack_braille(frame, out, capacity);
+}
+
+#endif
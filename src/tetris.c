@@ -9,9 +9,25 @@
 #include <sys/select.h>
 #include <sys/time.h>
 
+#include "savestate.h"
+#include "subpixel.h"
+#include "capture.h"
+#include "launchstat.h"
+#include "plugin.h"
+
 #define ROWS 15
 #define COLS 15
-#define TIME_INTERVAL 500000
+#define GRAVITY_INTERVAL 500000
+#define DEFAULT_DAS_MS 170
+#define DEFAULT_ARR_MS 50
+#define DEFAULT_SDF 20
+#define DEFAULT_LOCK_MS 500
+#define MAX_LOCK_RESETS 15
+#define TTY_RELEASE_US 80000
+#define TTY_HOLD_BYTES 3
+#define REWIND_INTERVAL 50000
+#define SAVE_SLOT "tetris.sav"
+#define SAVE_ID SAVESTATE_ID('T', 'E', 'T', 'R')
 
 struct termios orig_termios;
 
@@ -24,10 +40,70 @@ typedef struct {
     int type;
 } Tetromino;
 
+typedef struct {
+    char grid[ROWS][COLS];
+    Tetromino current_tetromino;
+    int tetromino_active;
+} TetrisState;
+
+/*
+ * Movement is timed in CLOCK_MONOTONIC microseconds, not in ticks. A held
+ * a/d shifts once on press, again `das` later and then every `arr` (0 slides
+ * straight to the wall); a held s divides gravity by `sdf`. A piece resting
+ * on the stack locks `lock` after it lands, and up to MAX_LOCK_RESETS shifts
+ * or rotations restart that delay. tick_game() runs at tetris_deadline(),
+ * the earliest of these timers, rather than on a fixed interval.
+ */
+typedef struct {
+    long das;
+    long arr;
+    long sdf;
+    long lock;
+} Timing;
+
+/*
+ * Terminal keys have no release: a tty key only counts as held from the
+ * TTY_HOLD_BYTES-th byte of a run arriving less than TTY_RELEASE_US apart,
+ * and is let go TTY_RELEASE_US after the last byte. Until then every byte
+ * is a tap, so a fast double tap moves twice instead of auto-shifting.
+ */
+typedef struct {
+    int held;
+    int source;
+    int run;
+    long pressed_at;
+    long last_shift;
+    long last_seen;
+} HeldKey;
+
 char grid[ROWS][COLS];
 Tetromino current_tetromino;
 int tetromino_active = 0;
 int game_over = 0;
+int quit = 0;
+int rewind_held = 0;
+
+SaveStateRing history;
+
+Timing timing;
+HeldKey left_key, right_key, down_key;
+long next_gravity = 0;
+long next_rewind = 0;
+int engine_due = 0;
+long lock_started = 0;
+int lock_resets = 0;
+
+unsigned long input_moves = 0;
+long long move_latency_total_ns = 0;
+long long move_latency_max_ns = 0;
+unsigned long auto_shifts = 0;
+long long shift_late_total_us = 0;
+long long shift_late_max_us = 0;
+
+RenderMode render_mode = RENDER_TEXT;
+SubpixelFrame frame;
+char frame_output[SUBPIXEL_MAX_WIDTH * SUBPIXEL_MAX_HEIGHT];
+int headless = 0;
 
 const Point tetromino_shapes[7][4] = {
     {{0, -1}, {0, 0}, {0, 1}, {0, 2}},
@@ -39,6 +115,9 @@ const Point tetromino_shapes[7][4] = {
     {{-1, 0}, {0, 0}, {1, 0}, {1, -1}}
 };
 
+void record_state();
+
+#ifndef VGC_PLUGIN
 void disableRawMode() {
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
 }
@@ -53,23 +132,127 @@ void enableRawMode() {
     raw.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
 }
+#endif
 
-void handle_exit() {
-    disableRawMode();
-    exit(0);
+long timing_from_env(const char *name, long default_value) {
+    const char *value = getenv(name);
+    if (value == NULL || *value == '\0' || atol(value) < 0) {
+        return default_value;
+    }
+    return atol(value);
 }
 
-void signal_handler(int signum) {
-    handle_exit();
+void load_timing() {
+    timing.das = timing_from_env("VGC_DAS_MS", DEFAULT_DAS_MS) * 1000;
+    timing.arr = timing_from_env("VGC_ARR_MS", DEFAULT_ARR_MS) * 1000;
+    timing.sdf = timing_from_env("VGC_SDF", DEFAULT_SDF);
+    timing.lock = timing_from_env("VGC_LOCK_MS", DEFAULT_LOCK_MS) * 1000;
+    if (timing.sdf < 1) {
+        timing.sdf = 1;
+    }
 }
 
-void init_game() {
-    enableRawMode();
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+int init_game() {
     srand(time(NULL));
     memset(grid, '.', sizeof(grid));
     tetromino_active = 0;
+    game_over = 0;
+    quit = 0;
+    rewind_held = 0;
+    load_timing();
+    memset(&left_key, 0, sizeof(left_key));
+    memset(&right_key, 0, sizeof(right_key));
+    memset(&down_key, 0, sizeof(down_key));
+    lock_started = 0;
+    lock_resets = 0;
+    engine_due = 0;
+    input_moves = 0;
+    move_latency_total_ns = 0;
+    move_latency_max_ns = 0;
+    auto_shifts = 0;
+    shift_late_total_us = 0;
+    shift_late_max_us = 0;
+    launchstat_begin();
+    headless = capture_headless();
+    capture_start();
+    render_mode = render_mode_from_env();
+    if (render_mode != RENDER_TEXT) {
+        subpixel_init(&frame, COLS * subpixel_cell_width(render_mode), ROWS * subpixel_cell_height(render_mode));
+    }
+    savestate_init(&history, sizeof(TetrisState));
+    record_state();
+    return 0;
+}
+
+void capture_state(TetrisState *state) {
+    memset(state, 0, sizeof(*state));
+    memcpy(state->grid, grid, sizeof(grid));
+    state->current_tetromino = current_tetromino;
+    state->tetromino_active = tetromino_active;
+}
+
+void restore_state(const TetrisState *state) {
+    memcpy(grid, state->grid, sizeof(grid));
+    current_tetromino = state->current_tetromino;
+    tetromino_active = state->tetromino_active;
+}
+
+void record_state() {
+    TetrisState state;
+    capture_state(&state);
+    savestate_push(&history, &state);
+}
+
+int rewind_state() {
+    TetrisState state;
+    if (savestate_rewind(&history, &state) != 0) {
+        return 0;
+    }
+    restore_state(&state);
+    return 1;
+}
+
+void quick_save() {
+    TetrisState state;
+    capture_state(&state);
+    savestate_write_slot(SAVE_SLOT, SAVE_ID, &state, sizeof(state));
+}
+
+/* Slot files are only checksummed, so reject cells and pieces the game could not index. */
+int valid_state(const TetrisState *state) {
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLS; j++) {
+            if (state->grid[i][j] != '.' && state->grid[i][j] != '#') {
+                return 0;
+            }
+        }
+    }
+    if (state->tetromino_active != 0 && state->tetromino_active != 1) {
+        return 0;
+    }
+    if (!state->tetromino_active) {
+        return 1;
+    }
+    const Tetromino *t = &state->current_tetromino;
+    if (t->type < 0 || t->type >= 7) {
+        return 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (t->blocks[i].x < 0 || t->blocks[i].x >= COLS || t->blocks[i].y < -4 || t->blocks[i].y >= ROWS) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int quick_load() {
+    TetrisState state;
+    if (savestate_read_slot(SAVE_SLOT, SAVE_ID, &state, sizeof(state)) == 0 && valid_state(&state)) {
+        restore_state(&state);
+        record_state();
+        return 1;
+    }
+    return 0;
 }
 
 void create_tetromino() {
@@ -82,8 +265,12 @@ void create_tetromino() {
     tetromino_active = 1;
 }
 
-void draw_game() {
-    system("clear");
+void draw_grid_subpixel(OutputFrame *out, char cells[ROWS][COLS]) {
+    subpixel_draw_cells(&frame, render_mode, &cells[0][0], ROWS, COLS, '.', 0);
+    frame_write(out, frame_output, subpixel_pack(&frame, render_mode, frame_output, sizeof(frame_output)));
+}
+
+void draw_game(OutputFrame *out) {
     char display_grid[ROWS][COLS];
     memcpy(display_grid, grid, sizeof(grid));
     if (tetromino_active) {
@@ -95,11 +282,18 @@ void draw_game() {
             }
         }
     }
+    launchstat_first_frame("tetris");
+    capture_frame(&display_grid[0][0], ROWS, COLS);
+    if (headless) {
+        return;
+    }
+    if (render_mode != RENDER_TEXT) {
+        draw_grid_subpixel(out, display_grid);
+        return;
+    }
     for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            printf("%c", display_grid[i][j]);
-        }
-        printf("\n");
+        frame_write(out, display_grid[i], COLS);
+        frame_write(out, "\n", 1);
     }
 }
 
@@ -156,7 +350,7 @@ void clear_lines() {
     }
 }
 
-void rotate_tetromino(Tetromino *tetromino) {
+int rotate_tetromino(Tetromino *tetromino) {
     Tetromino temp = *tetromino;
     for (int i = 0; i < 4; i++) {
         int x = tetromino->blocks[i].x;
@@ -168,77 +362,375 @@ void rotate_tetromino(Tetromino *tetromino) {
         temp.blocks[i].x = rx;
         temp.blocks[i].y = ry;
     }
-    if (!check_collision(&temp, 0, 0, 0)) {
-        *tetromino = temp;
+    if (check_collision(&temp, 0, 0, 0)) {
+        return 0;
     }
+    *tetromino = temp;
+    return 1;
 }
 
-void update_game() {
-    if (!tetromino_active) {
-        create_tetromino();
-        if (check_collision(&current_tetromino, 0, 0, 0)) {
-            game_over = 1;
-            return;
+int move_tetromino(int dx, int dy) {
+    if (!tetromino_active || check_collision(&current_tetromino, dx, dy, 0)) {
+        return 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        current_tetromino.blocks[i].x += dx;
+        current_tetromino.blocks[i].y += dy;
+    }
+    return 1;
+}
+
+long gravity_interval() {
+    return down_key.held ? GRAVITY_INTERVAL / timing.sdf : GRAVITY_INTERVAL;
+}
+
+void reset_timers(long now) {
+    next_gravity = now + GRAVITY_INTERVAL;
+    lock_started = 0;
+}
+
+void spawn_tetromino(long now) {
+    create_tetromino();
+    reset_timers(now);
+    lock_resets = 0;
+    if (check_collision(&current_tetromino, 0, 0, 0)) {
+        game_over = 1;
+    }
+}
+
+void lock_tetromino() {
+    merge_tetromino(&current_tetromino);
+    tetromino_active = 0;
+    lock_started = 0;
+    clear_lines();
+}
+
+/* A shift or rotation on the stack buys the piece a fresh lock delay. */
+void extend_lock(long now) {
+    if (lock_started && lock_resets < MAX_LOCK_RESETS) {
+        lock_started = now;
+        lock_resets++;
+    }
+}
+
+void release_stale_key(HeldKey *key, long now) {
+    if (key->held && key->source == INPUT_SOURCE_TTY && now - key->last_seen >= TTY_RELEASE_US) {
+        key->held = 0;
+    }
+}
+
+/* Returns 1 when the press or tty byte moves the piece once, 0 for autorepeat of a held key. */
+int press_key(HeldKey *key, const InputEvent *event) {
+    long at = event->time_ns / 1000;
+    if (event->source == INPUT_SOURCE_TTY && key->source == INPUT_SOURCE_TTY &&
+        key->last_seen && at - key->last_seen < TTY_RELEASE_US) {
+        key->last_seen = at;
+        if (key->held) {
+            return 0;
         }
+        if (++key->run >= TTY_HOLD_BYTES - 1) {
+            key->held = 1;
+            key->pressed_at = at - timing.das;
+            key->last_shift = at;
+        }
+        return 1;
     }
-    if (!check_collision(&current_tetromino, 0, 1, 0)) {
-        for (int i = 0; i < 4; i++) {
-            current_tetromino.blocks[i].y += 1;
+    key->held = event->source != INPUT_SOURCE_TTY;
+    key->source = event->source;
+    key->run = 0;
+    key->pressed_at = at;
+    key->last_shift = at + timing.das - timing.arr;
+    key->last_seen = at;
+    return 1;
+}
+
+/* The most recently pressed of the held a/d keys, or NULL. */
+HeldKey *shift_key(int *direction) {
+    HeldKey *key = NULL;
+    if (left_key.held) {
+        key = &left_key;
+        *direction = -1;
+    }
+    if (right_key.held && (key == NULL || right_key.pressed_at > key->pressed_at)) {
+        key = &right_key;
+        *direction = 1;
+    }
+    return key;
+}
+
+int update_shift(long now) {
+    int direction = 0;
+    int moved = 0;
+    HeldKey *key = shift_key(&direction);
+
+    if (key == NULL || now - key->pressed_at < timing.das) {
+        return 0;
+    }
+    if (timing.arr == 0) {
+        while (move_tetromino(direction, 0)) {
+            moved = 1;
         }
     } else {
-        merge_tetromino(&current_tetromino);
-        tetromino_active = 0;
-        clear_lines();
+        while (now - key->last_shift >= timing.arr) {
+            key->last_shift += timing.arr;
+            if (!move_tetromino(direction, 0)) {
+                key->last_shift = now;
+                break;
+            }
+            long late = now - key->last_shift;
+            auto_shifts++;
+            shift_late_total_us += late;
+            if (late > shift_late_max_us) {
+                shift_late_max_us = late;
+            }
+            moved = 1;
+        }
+    }
+    if (moved) {
+        extend_lock(now);
     }
+    return moved;
 }
 
-int main() {
-    init_game();
-    struct timeval last_time, current_time;
-    gettimeofday(&last_time, NULL);
-    while (!game_over) {
-        draw_game();
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds);
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 100000;
-        int select_result = select(STDIN_FILENO + 1, &read_fds, NULL, NULL, &tv);
-        if (select_result > 0) {
-            char c;
-            read(STDIN_FILENO, &c, 1);
-            c = tolower(c);
-            if (c == 'q') {
-                handle_exit();
-            } else if (tetromino_active) {
-                if (c == 'a' && !check_collision(&current_tetromino, -1, 0, 0)) {
-                    for (int i = 0; i < 4; i++) {
-                        current_tetromino.blocks[i].x -= 1;
-                    }
-                } else if (c == 'd' && !check_collision(&current_tetromino, 1, 0, 0)) {
-                    for (int i = 0; i < 4; i++) {
-                        current_tetromino.blocks[i].x += 1;
-                    }
-                } else if (c == 's' && !check_collision(&current_tetromino, 0, 1, 0)) {
-                    for (int i = 0; i < 4; i++) {
-                        current_tetromino.blocks[i].y += 1;
-                    }
-                } else if (c == 'w') {
-                    rotate_tetromino(&current_tetromino);
-                }
-            }
+int update_gravity(long now) {
+    int moved = 0;
+    while (now >= next_gravity) {
+        if (!move_tetromino(0, 1)) {
+            next_gravity = now + gravity_interval();
+            break;
+        }
+        next_gravity += gravity_interval();
+        moved = 1;
+    }
+    return moved;
+}
+
+int update_lock(long now) {
+    if (!check_collision(&current_tetromino, 0, 1, 0)) {
+        lock_started = 0;
+        return 0;
+    }
+    if (lock_started == 0) {
+        lock_started = now;
+        return 0;
+    }
+    if (now - lock_started < timing.lock) {
+        return 0;
+    }
+    lock_tetromino();
+    return 1;
+}
+
+long earliest(long deadline, long at) {
+    return at < deadline ? at : deadline;
+}
+
+long tty_release_time(const HeldKey *key, long deadline) {
+    if (key->held && key->source == INPUT_SOURCE_TTY) {
+        return earliest(deadline, key->last_seen + TTY_RELEASE_US);
+    }
+    return deadline;
+}
+
+/* When tick_game() next has work: the earliest gravity, shift, lock, rewind or tty release timer. */
+long tetris_deadline() {
+    if (rewind_held) {
+        return next_rewind;
+    }
+    if (engine_due || !tetromino_active) {
+        return 0;
+    }
+    long deadline = next_gravity;
+    int direction = 0;
+    HeldKey *key = shift_key(&direction);
+    if (key != NULL) {
+        long das_at = key->pressed_at + timing.das;
+        if (timing.arr > 0) {
+            long repeat_at = key->last_shift + timing.arr;
+            deadline = earliest(deadline, repeat_at > das_at ? repeat_at : das_at);
+        } else if (vgc_now_us() < das_at) {
+            deadline = earliest(deadline, das_at);
+        }
+    }
+    if (lock_started) {
+        deadline = earliest(deadline, lock_started + timing.lock);
+    }
+    deadline = tty_release_time(&left_key, deadline);
+    deadline = tty_release_time(&right_key, deadline);
+    return tty_release_time(&down_key, deadline);
+}
+
+int tick_game() {
+    long now = vgc_now_us();
+    int changed = 0;
+
+    engine_due = 0;
+
+    if (rewind_held) {
+        if (now < next_rewind) {
+            return 0;
+        }
+        next_rewind += REWIND_INTERVAL;
+        if (next_rewind <= now) {
+            next_rewind = now + REWIND_INTERVAL;
+        }
+        if (!rewind_state()) {
+            return 0;
+        }
+        reset_timers(now);
+        return VGC_REDRAW;
+    }
+    if (!tetromino_active) {
+        spawn_tetromino(now);
+        if (game_over) {
+            return VGC_REDRAW;
         }
-        gettimeofday(&current_time, NULL);
-        long elapsed = (current_time.tv_sec - last_time.tv_sec) * 1000000L +
-                       (current_time.tv_usec - last_time.tv_usec);
-        if (elapsed >= TIME_INTERVAL) {
-            update_game();
-            last_time = current_time;
+        changed = 1;
+    }
+    release_stale_key(&left_key, now);
+    release_stale_key(&right_key, now);
+    release_stale_key(&down_key, now);
+    changed |= update_shift(now);
+    changed |= update_gravity(now);
+    changed |= update_lock(now);
+    if (changed) {
+        record_state();
+    }
+    return changed ? VGC_REDRAW : 0;
+}
+
+void render_game(OutputFrame *out, long since_tick) {
+    draw_game(out);
+    if (game_over && !headless) {
+        frame_printf(out, "Game Over!\n");
+    }
+}
+
+int handle_input(const InputEvent *event) {
+    char c = tolower(event->key);
+    long now = vgc_now_us();
+    int moved = 0;
+
+    if (!event->pressed) {
+        if (c == 'a') left_key.held = 0;
+        else if (c == 'd') right_key.held = 0;
+        else if (c == 's') down_key.held = 0;
+        else if (c == 'r') rewind_held = 0;
+        return 0;
+    }
+    if (c == 'q') {
+        quit = 1;
+        return 0;
+    } else if (c == 'r') {
+        rewind_held = event->source == INPUT_SOURCE_EVDEV;
+        next_rewind = now + REWIND_INTERVAL;
+        if (!rewind_state()) {
+            return 0;
+        }
+        reset_timers(now);
+        return VGC_REDRAW | VGC_RESTART_TICK;
+    } else if (c == 'k') {
+        quick_save();
+        return 0;
+    } else if (c == 'l') {
+        if (!quick_load()) {
+            return 0;
+        }
+        reset_timers(now);
+        return VGC_REDRAW;
+    } else if (!tetromino_active) {
+        return 0;
+    } else if (c == 'a' || c == 'd') {
+        if (press_key(c == 'a' ? &left_key : &right_key, event) && move_tetromino(c == 'a' ? -1 : 1, 0)) {
+            extend_lock(now);
+            moved = 1;
         }
+    } else if (c == 's') {
+        if (press_key(&down_key, event)) {
+            moved = move_tetromino(0, 1);
+            next_gravity = now + gravity_interval();
+        }
+    } else if (c == 'w') {
+        if (rotate_tetromino(&current_tetromino)) {
+            extend_lock(now);
+            moved = 1;
+        }
+    } else if (c == ' ') {
+        while (move_tetromino(0, 1)) {
+        }
+        lock_tetromino();
+        moved = 1;
+    }
+    if (!moved) {
+        return 0;
+    }
+    engine_due = 1;
+    long long latency = input_now_ns() - event->time_ns;
+    input_moves++;
+    move_latency_total_ns += latency;
+    if (latency > move_latency_max_ns) {
+        move_latency_max_ns = latency;
+    }
+    record_state();
+    return VGC_REDRAW;
+}
+
+void report_timing() {
+    const char *stats = getenv("VGC_INPUT_STATS");
+    if (stats == NULL || strcmp(stats, "0") == 0) {
+        return;
+    }
+    if (input_moves > 0) {
+        fprintf(stderr, "tetris: %lu moves from input, input-to-move latency avg %.1f us, max %.1f us\n",
+                input_moves, move_latency_total_ns / 1000.0 / input_moves, move_latency_max_ns / 1000.0);
+    }
+    if (auto_shifts > 0) {
+        fprintf(stderr, "tetris: %lu auto-shifts, late by avg %.1f us, max %lld us\n",
+                auto_shifts, (double)shift_late_total_us / auto_shifts, shift_late_max_us);
     }
-    draw_game();
-    printf("Game Over!\n");
+}
+
+void shutdown_game() {
+    report_timing();
+    capture_stop();
+}
+
+int game_finished() {
+    return game_over || quit;
+}
+
+VGC_EXPORT VgcGame vgc_game = {
+    VGC_ABI_VERSION,
+    "tetris",
+    0,
+    0,
+    init_game,
+    tick_game,
+    render_game,
+    handle_input,
+    shutdown_game,
+    game_finished,
+    tetris_deadline
+};
+
+#ifndef VGC_PLUGIN
+void handle_exit() {
+    output_finish();
+    shutdown_game();
+    disableRawMode();
+    exit(0);
+}
+
+void signal_handler(int signum) {
     handle_exit();
+}
+
+int main() {
+    enableRawMode();
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    vgc_run_game(&vgc_game);
+    disableRawMode();
     return 0;
 }
+#endif
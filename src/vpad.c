@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#define PAD_NAME "VGC Virtual Pad"
+#define TAP_MS 50
+#define SETTLE_MS 500
+
+typedef struct {
+    const char *name;
+    int code;
+} PadButton;
+
+const PadButton pad_buttons[] = {
+    {"w", BTN_DPAD_UP},
+    {"a", BTN_DPAD_LEFT},
+    {"s", BTN_DPAD_DOWN},
+    {"d", BTN_DPAD_RIGHT},
+    {"q", BTN_SELECT},
+    {"r", BTN_TL},
+    {"space", BTN_EAST},
+    {"south", BTN_SOUTH},
+    {"start", BTN_START},
+};
+const int num_pad_buttons = sizeof(pad_buttons) / sizeof(pad_buttons[0]);
+
+int uinput_fd = -1;
+
+void sleep_ms(long ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+void emit(int type, int code, int value) {
+    struct input_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    if (write(uinput_fd, &ev, sizeof(ev)) != sizeof(ev)) {
+        perror("Error writing event");
+    }
+}
+
+void set_button(int code, int pressed) {
+    emit(EV_KEY, code, pressed);
+    emit(EV_SYN, SYN_REPORT, 0);
+}
+
+int find_button(const char *name) {
+    for (int i = 0; i < num_pad_buttons; i++) {
+        if (strcmp(pad_buttons[i].name, name) == 0) {
+            return pad_buttons[i].code;
+        }
+    }
+    return -1;
+}
+
+void print_event_node() {
+    char sysname[64];
+    char path[128];
+
+    if (ioctl(uinput_fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) {
+        return;
+    }
+    snprintf(path, sizeof(path), "/sys/devices/virtual/input/%s", sysname);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "event", 5) == 0) {
+            printf("/dev/input/%s\n", entry->d_name);
+            fflush(stdout);
+        }
+    }
+    closedir(dir);
+}
+
+int create_pad() {
+    struct uinput_setup setup;
+
+    uinput_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (uinput_fd < 0) {
+        perror("Error opening /dev/uinput");
+        return -1;
+    }
+    ioctl(uinput_fd, UI_SET_EVBIT, EV_KEY);
+    for (int i = 0; i < num_pad_buttons; i++) {
+        ioctl(uinput_fd, UI_SET_KEYBIT, pad_buttons[i].code);
+    }
+
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x1209;
+    setup.id.product = 0x0001;
+    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, PAD_NAME);
+    if (ioctl(uinput_fd, UI_DEV_SETUP, &setup) < 0 || ioctl(uinput_fd, UI_DEV_CREATE) < 0) {
+        perror("Error creating virtual pad");
+        close(uinput_fd);
+        return -1;
+    }
+    return 0;
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s STEP...\n", program);
+    fprintf(stderr, "  +BUTTON  press   -BUTTON  release   BUTTON  tap   MS  wait\n");
+    fprintf(stderr, "  buttons:");
+    for (int i = 0; i < num_pad_buttons; i++) {
+        fprintf(stderr, " %s", pad_buttons[i].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (create_pad() != 0) {
+        return 1;
+    }
+    print_event_node();
+    sleep_ms(SETTLE_MS);
+
+    for (int i = 1; i < argc; i++) {
+        const char *step = argv[i];
+        if (step[0] >= '0' && step[0] <= '9') {
+            sleep_ms(atol(step));
+            continue;
+        }
+        int pressed = step[0] == '+' ? 1 : step[0] == '-' ? 0 : -1;
+        int code = find_button(pressed >= 0 ? step + 1 : step);
+        if (code < 0) {
+            fprintf(stderr, "Unknown button '%s'\n", step);
+            continue;
+        }
+        if (pressed >= 0) {
+            set_button(code, pressed);
+        } else {
+            set_button(code, 1);
+            sleep_ms(TAP_MS);
+            set_button(code, 0);
+        }
+    }
+
+    sleep_ms(SETTLE_MS);
+    ioctl(uinput_fd, UI_DEV_DESTROY);
+    close(uinput_fd);
+    return 0;
+}
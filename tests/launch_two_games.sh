@@ -0,0 +1,26 @@
+#!/bin/sh
+# Launches two different plugin games in one launcher session and checks
+# that each one actually ran. Needs gcc and script(1).
+set -e
+
+src=$(cd "$(dirname "$0")/../src" && pwd)
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+gcc -O2 -pthread -o "$dir/main-screen" "$src/main-screen.c" -ldl
+for game in pong snake; do
+    gcc -O2 -pthread -fPIC -shared -fvisibility=hidden -DVGC_PLUGIN -o "$dir/game_$game.so" "$src/$game.c"
+done
+
+cd "$dir"
+# Start the first game, quit it, pick the next game from the menu, start and quit that.
+(sleep 1; printf '\r'; sleep 1; printf q; sleep 1; printf 'ds\r'; sleep 1; printf q; sleep 1; printf q) |
+    VGC_HEADLESS=1 script -qc ./main-screen /dev/null > /dev/null
+
+games=$(cut -d' ' -f1 launch.log | sort -u | tr '\n' ' ')
+if [ "$(wc -l < launch.log)" -ne 2 ] || [ "$games" != "pong snake " ]; then
+    echo "launch_two_games: expected pong and snake in launch.log, got:" >&2
+    cat launch.log >&2
+    exit 1
+fi
+echo "launch_two_games: ok"
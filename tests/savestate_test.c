@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/savestate.h"
+
+#define GUARD_SIZE 4096
+#define GUARD_BYTE 0xa5
+
+typedef struct {
+    SaveStateRing ring;
+    unsigned char guard[GUARD_SIZE];
+} GuardedRing;
+
+static GuardedRing guarded;
+static unsigned char pushed[SAVESTATE_HISTORY][SAVESTATE_MAX_STATE];
+static int failures = 0;
+
+static void check(int ok, const char *what, size_t size, unsigned long step) {
+    if (!ok) {
+        fprintf(stderr, "FAIL %s (state %zu bytes, push %lu)\n", what, size, step);
+        failures++;
+    }
+}
+
+static int guard_intact() {
+    for (size_t i = 0; i < GUARD_SIZE; i++) {
+        if (guarded.guard[i] != GUARD_BYTE) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Worst case for the codec: every other byte differs from the keyframe. */
+static void make_state(unsigned char *state, size_t size, unsigned long step) {
+    for (size_t i = 0; i < size; i++) {
+        if (step % 3 == 0) {
+            state[i] = (i + step) % 2 ? '#' : '.';
+        } else if (step % 3 == 1) {
+            state[i] = (unsigned char)rand();
+        } else {
+            state[i] = (i % 7 == step % 7) ? (unsigned char)step : '.';
+        }
+    }
+}
+
+static void test_codec(size_t size) {
+    unsigned char ref[SAVESTATE_MAX_STATE];
+    unsigned char cur[SAVESTATE_MAX_STATE];
+    unsigned char out[SAVESTATE_MAX_ENCODED(SAVESTATE_MAX_STATE)];
+
+    for (size_t i = 0; i < size; i++) {
+        ref[i] = '.';
+        cur[i] = i % 2 ? '#' : '.';
+    }
+    size_t len = savestate_encode(ref, cur, size, out);
+    check(len <= SAVESTATE_MAX_ENCODED(size), "alternating delta fits the reserve", size, 0);
+    savestate_apply(ref, size, out, len);
+    check(memcmp(ref, cur, size) == 0, "alternating delta round-trips", size, 0);
+
+    /* A truncated or oversized delta must stay inside the state. */
+    unsigned char bogus[4] = {0x7f, 1, 2, 3};
+    savestate_apply(ref, 1, bogus, sizeof(bogus));
+}
+
+static void test_ring(size_t size, unsigned long pushes) {
+    memset(guarded.guard, GUARD_BYTE, sizeof(guarded.guard));
+    check(savestate_init(&guarded.ring, size) == 0, "init", size, 0);
+
+    for (unsigned long step = 0; step < pushes; step++) {
+        unsigned char *state = pushed[step % SAVESTATE_HISTORY];
+        make_state(state, size, step);
+        savestate_push(&guarded.ring, state);
+        check(guard_intact(), "pool stays in bounds", size, step);
+
+        size_t count = savestate_count(&guarded.ring);
+        check(count >= 1 && count <= SAVESTATE_HISTORY && count <= step + 1, "count", size, step);
+        if (step % 97 == 0 || step + 1 == pushes) {
+            unsigned char out[SAVESTATE_MAX_STATE];
+            for (size_t age = 0; age < count; age++) {
+                savestate_get(&guarded.ring, age, out);
+                if (memcmp(out, pushed[(step - age) % SAVESTATE_HISTORY], size) != 0) {
+                    check(0, "snapshot round-trips", size, step);
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Rewind back through whatever survived eviction. */
+    unsigned long step = pushes - 1;
+    unsigned char out[SAVESTATE_MAX_STATE];
+    while (savestate_rewind(&guarded.ring, out) == 0) {
+        step--;
+        if (memcmp(out, pushed[step % SAVESTATE_HISTORY], size) != 0) {
+            check(0, "rewind round-trips", size, step);
+            break;
+        }
+    }
+    check(savestate_count(&guarded.ring) == 1, "rewind stops at the oldest snapshot", size, step);
+}
+
+int main() {
+    srand(1);
+    test_codec(268);
+    test_codec(SAVESTATE_MAX_STATE);
+
+    /* Small states fill the entry table and evict by count. */
+    test_ring(16, SAVESTATE_HISTORY * 3);
+    /* Tetris-sized states wrap the pool and evict by overlap. */
+    test_ring(268, 5000);
+    test_ring(SAVESTATE_MAX_STATE, 500);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("savestate: ok\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/subpixel.h"
+
+#define OUT_SIZE (SUBPIXEL_MAX_WIDTH * SUBPIXEL_MAX_HEIGHT * 3)
+#define BENCH_WIDTH 400
+#define BENCH_HEIGHT 200
+#define BENCH_FRAMES 2000
+
+static SubpixelFrame frame;
+static char packed[OUT_SIZE];
+static char expected[OUT_SIZE];
+static int failures = 0;
+
+static int pixel(int x, int y) {
+    if (x >= frame.width || y >= frame.height) {
+        return 0;
+    }
+    return (frame.bits[y][x / 64] >> (x % 64)) & 1;
+}
+
+static void put_utf8(char *out, size_t *len, int code) {
+    out[(*len)++] = (char)(0xe0 | (code >> 12));
+    out[(*len)++] = (char)(0x80 | ((code >> 6) & 0x3f));
+    out[(*len)++] = (char)(0x80 | (code & 0x3f));
+}
+
+/* One subpixel at a time, straight from the Unicode dot numbering. */
+static size_t reference_braille(char *out) {
+    static const int dots[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+    size_t len = 0;
+    for (int y = 0; y < frame.height; y += 4) {
+        for (int x = 0; x < frame.width; x += 2) {
+            int code = 0x2800;
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 2; c++) {
+                    if (pixel(x + c, y + r)) code |= dots[r][c];
+                }
+            }
+            put_utf8(out, &len, code);
+        }
+        out[len++] = '\n';
+    }
+    return len;
+}
+
+static size_t reference_halfblock(char *out) {
+    size_t len = 0;
+    for (int y = 0; y < frame.height; y += 2) {
+        for (int x = 0; x < frame.width; x++) {
+            int top = pixel(x, y), bottom = pixel(x, y + 1);
+            if (top && bottom) put_utf8(out, &len, 0x2588);
+            else if (top) put_utf8(out, &len, 0x2580);
+            else if (bottom) put_utf8(out, &len, 0x2584);
+            else out[len++] = ' ';
+        }
+        out[len++] = '\n';
+    }
+    return len;
+}
+
+static void random_frame(int width, int height) {
+    subpixel_init(&frame, width, height);
+    for (int i = 0; i < width * height / 3; i++) {
+        subpixel_set(&frame, rand() % width, rand() % height);
+    }
+    subpixel_fill_rect(&frame, rand() % width, rand() % height, rand() % 80, rand() % 20);
+}
+
+static void check_pack(int width, int height, RenderMode mode) {
+    random_frame(width, height);
+    size_t len = subpixel_pack(&frame, mode, packed, sizeof(packed));
+    size_t want = mode == RENDER_BRAILLE ? reference_braille(expected) : reference_halfblock(expected);
+    if (len != want || memcmp(packed, expected, len) != 0) {
+        fprintf(stderr, "FAIL %s pack of %dx%d\n", mode == RENDER_BRAILLE ? "braille" : "halfblock", width, height);
+        failures++;
+    }
+}
+
+static double bench(RenderMode mode) {
+    struct timespec start, end;
+    size_t total = 0;
+    random_frame(BENCH_WIDTH, BENCH_HEIGHT);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        frame.bits[i % BENCH_HEIGHT][0] ^= 1;
+        total += subpixel_pack(&frame, mode, packed, sizeof(packed));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (total == 0) {
+        failures++;
+    }
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1000.0 / BENCH_FRAMES;
+}
+
+int main() {
+    srand(1);
+    int sizes[][2] = {{1, 1}, {2, 4}, {30, 60}, {63, 7}, {64, 8}, {65, 9}, {129, 33}, {400, 200}, {512, 256}};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        check_pack(sizes[i][0], sizes[i][1], RENDER_BRAILLE);
+        check_pack(sizes[i][0], sizes[i][1], RENDER_HALFBLOCK);
+    }
+    if (failures > 0) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("subpixel: ok, %dx%d braille %.1f us, halfblock %.1f us per frame\n",
+           BENCH_WIDTH, BENCH_HEIGHT, bench(RENDER_BRAILLE), bench(RENDER_HALFBLOCK));
+    return 0;
+}